@@ -0,0 +1,223 @@
+// fms_iterable.bench.cpp - benchmark fms::iterable adaptors against hand-written loops
+// Usage: fms_iterable.bench [n] [--csv file] [--json file]
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "fms_time.h"
+#include "fms_iterable.h"
+#include "fms_iterable_any.h"
+#include "fms_iterable_channel.h"
+#include "fms_iterable_generator.h"
+#include "fms_iterable_join.h"
+#include "fms_iterable_prefetch.h"
+#include "fms_iterable_recurrence.h"
+#include "fms_iterable_rolling.h"
+
+using namespace fms::iterable;
+
+// Run iterable and hand-written versions of the same computation.
+template<class I, class L>
+inline void bench(std::vector<fms::timing>& ts, const std::string& name, std::size_t n, I i, L l)
+{
+	ts.push_back(fms::benchmark(name, [&]() { fms::do_not_optimize(i()); }, n));
+	ts.push_back(fms::benchmark(name + "_loop", [&]() { fms::do_not_optimize(l()); }, n));
+}
+
+// Squares greater than 8 written as a coroutine.
+template<class A = frame_pool>
+inline generator<double, A> squares(const double* p, std::size_t n)
+{
+	for (std::size_t k = 0; k < n; ++k) {
+		if (p[k] * p[k] > 8) {
+			co_yield p[k] * p[k];
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t n = 1'000'000;
+	const char* csv = nullptr;
+	const char* json = nullptr;
+
+	for (int arg = 1; arg < argc; ++arg) {
+		if (0 == strcmp(argv[arg], "--csv") && arg + 1 < argc) {
+			csv = argv[++arg];
+		}
+		else if (0 == strcmp(argv[arg], "--json") && arg + 1 < argc) {
+			json = argv[++arg];
+		}
+		else {
+			n = std::strtoull(argv[arg], nullptr, 10);
+		}
+	}
+
+	std::vector<double> x(n), y(n);
+	for (std::size_t k = 0; k < n; ++k) {
+		x[k] = 1. + double(k % 101) / 7; // not sorted
+		y[k] = double(2 * k + 1); // sorted
+	}
+	std::vector<double> z(n);
+	for (std::size_t k = 0; k < n; ++k) {
+		z[k] = double(2 * k); // sorted
+	}
+	double* px = x.data();
+	double* py = y.data();
+	double* pz = z.data();
+
+	std::vector<fms::timing> ts;
+
+	bench(ts, "sum", n,
+		[=]() { return sum(pointer(px, n)); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) s += px[k]; return s; });
+	bench(ts, "sum_compensated", n,
+		[=]() { return sum<fms::simd::summation::compensated>(pointer(px, n)); },
+		[=]() { double s = 0, c = 0; for (std::size_t k = 0; k < n; ++k) { double t = s + px[k]; c += std::fabs(s) >= std::fabs(px[k]) ? (s - t) + px[k] : (px[k] - t) + s; s = t; } return s + c; });
+	bench(ts, "apply", n,
+		[=]() { return sum(apply([](double t) { return t * t; }, pointer(px, n))); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) s += px[k] * px[k]; return s; });
+	bench(ts, "binop", n,
+		[=]() { return sum(pointer(px, n) * pointer(py, n)); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) s += px[k] * py[k]; return s; });
+	bench(ts, "affine", n,
+		[=]() { return sum(1. + 2. * pointer(px, n)); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) s += 1. + 2. * px[k]; return s; });
+	bench(ts, "any_iterable", n,
+		[=]() { return sum(any_iterable<double>(apply([](double t) { return t * t; }, pointer(px, n)))); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) s += px[k] * px[k]; return s; });
+	bench(ts, "filter", n,
+		[=]() { return sum(filter([](double t) { return t > 8; }, pointer(px, n))); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) if (px[k] > 8) s += px[k]; return s; });
+	bench(ts, "filter_compare", n,
+		[=]() { return sum(pointer(px, n) > 8.); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) if (px[k] > 8) s += px[k]; return s; });
+	bench(ts, "until", n,
+		[=]() { return sum(until([](double t) { return t < 0; }, pointer(px, n))); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n && !(px[k] < 0); ++k) s += px[k]; return s; });
+	bench(ts, "fold", n,
+		[=]() { return back(fold(std::plus<double>{}, pointer(px, n), 0.)); },
+		[=]() { double s = 0; for (std::size_t k = 0; k + 1 < n; ++k) s += px[k]; return s; });
+	// against recomputing each window of 32
+	bench(ts, "rolling_max", n,
+		[=]() { return sum(rolling_max(pointer(px, n), 32)); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) s += *std::max_element(px + (k < 31 ? 0 : k - 31), px + k + 1); return s; });
+	bench(ts, "ewma", n,
+		[=]() { return sum(ewma(0.1, pointer(px, n))); },
+		[=]() { double s = 0, m = px[0]; for (std::size_t k = 0; k < n; ++k) s += (m = 0.9 * m + 0.1 * px[k]); return s; });
+	bench(ts, "ewma_fold", n,
+		[=]() { return sum(fold([](double m, double x) { return 0.9 * m + 0.1 * x; }, pointer(px, n), px[0])); },
+		[=]() { double s = 0, m = px[0]; for (std::size_t k = 0; k < n; ++k) s += (m = 0.9 * m + 0.1 * px[k]); return s; });
+	// n/64 rows of 64 instruments
+	const auto rows = [=]() { return apply([=](std::size_t r) { return std::span<const double>(px + 64 * r, 64); }, take(iota<std::size_t>(0), n / 64)); };
+	bench(ts, "ewma_columns", n,
+		[=]() { double s = 0; for (auto e = ewma_columns(0.1, rows(), 64); e; ++e) s += (*e)[63]; return s; },
+		[=]() { double s = 0; for (std::size_t c = 0; c < 64; ++c) { auto e = ewma(0.1, apply([=](std::size_t r) { return px[64 * r + c]; }, take(iota<std::size_t>(0), n / 64))); if (c == 63) s = sum(e); else fms::do_not_optimize(sum(e)); } return s; });
+	// latest even key at or before each odd key, then at every 64th odd key
+	bench(ts, "asof_join", n,
+		[=]() { double s = 0; for (auto a = asof_join(pointer(py, n), pointer(pz, n)); a; ++a) s += *(*a).second; return s; },
+		[=]() { double s = 0; std::size_t j = 0; for (std::size_t k = 0; k < n; ++k) { while (j + 1 < n && pz[j + 1] <= py[k]) ++j; s += pz[j]; } return s; });
+	bench(ts, "asof_join_sparse", n,
+		[=]() { double s = 0; for (auto a = asof_join(apply([=](std::size_t k) { return py[64 * k]; }, take(iota<std::size_t>(0), n / 64)), pointer(pz, n)); a; ++a) s += *(*a).second; return s; },
+		[=]() { double s = 0; std::size_t j = 0; for (std::size_t k = 0; k < n; k += 64) { while (j + 1 < n && pz[j + 1] <= py[k]) ++j; s += pz[j]; } return s; });
+	bench(ts, "merge2", 2 * n,
+		[=]() { return sum(merge2(pointer(py, n), pointer(pz, n))); },
+		[=]() {
+			double s = 0;
+			std::size_t j = 0, k = 0;
+			while (j < n && k < n) s += py[j] < pz[k] ? py[j++] : pz[k++];
+			while (j < n) s += py[j++];
+			while (k < n) s += pz[k++];
+			return s;
+		});
+	bench(ts, "merge8", n,
+		[=]() {
+			std::vector<pointer<const double>> is;
+			for (std::size_t j = 0; j < 8; ++j) {
+				is.push_back(pointer<const double>(py + j * (n / 8), n / 8));
+			}
+			return sum(merge(is));
+		},
+		[=]() {
+			using head = std::pair<double, std::size_t>;
+			std::priority_queue<head, std::vector<head>, std::greater<head>> q;
+			std::size_t m = n / 8, k[8] = {};
+			for (std::size_t j = 0; j < 8; ++j) {
+				if (m) q.push({ py[j * m], j });
+			}
+			double s = 0;
+			while (!q.empty()) {
+				auto [y, j] = q.top();
+				q.pop();
+				s += y;
+				if (++k[j] < m) q.push({ py[j * m + k[j]], j });
+			}
+			return s;
+		});
+	bench(ts, "concatenate2", 2 * n,
+		[=]() { return sum(concatenate2(pointer(px, n), pointer(py, n))); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) s += px[k]; for (std::size_t k = 0; k < n; ++k) s += py[k]; return s; });
+	bench(ts, "concatenate8", n,
+		[=]() {
+			std::vector<pointer<const double>> is;
+			for (std::size_t j = 0; j < 8; ++j) {
+				is.push_back(pointer<const double>(px + j * (n / 8), n / 8));
+			}
+			return sum(concatenate(is));
+		},
+		[=]() { double s = 0; for (std::size_t k = 0; k < n / 8 * 8; ++k) s += px[k]; return s; });
+	bench(ts, "delta", n,
+		[=]() { return sum(delta(pointer(px, n))); },
+		[=]() { double s = 0; for (std::size_t k = 1; k < n; ++k) s += px[k] - px[k - 1]; return s; });
+	bench(ts, "take", n,
+		[=]() { return sum(take(pointer(px), n)); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) s += px[k]; return s; });
+	bench(ts, "generator", n,
+		[=]() { return sum(generate(pointer(px, n))); },
+		[=]() { double s = 0; for (std::size_t k = 0; k < n; ++k) s += px[k]; return s; });
+	// coroutine against the equivalent adaptor chain
+	bench(ts, "generator_chain", n,
+		[=]() { return sum(squares(px, n)); },
+		[=]() { return sum(filter([](double t) { return t > 8; }, apply([](double t) { return t * t; }, pointer(px, n)))); });
+	// a short generator per 4 elements from the frame pool and from operator new
+	ts.push_back(fms::benchmark("generator_frame_pool", [=]() {
+		double s = 0; for (std::size_t k = 0; k + 4 <= n; k += 4) s += sum(squares(px + k, 4)); fms::do_not_optimize(s); }, n));
+	ts.push_back(fms::benchmark("generator_frame_new", [=]() {
+		double s = 0; for (std::size_t k = 0; k + 4 <= n; k += 4) s += sum(squares<new_delete>(px + k, 4)); fms::do_not_optimize(s); }, n));
+	// two stage pipeline on one thread and split across two threads
+	const auto stage = [](double t) { return std::exp(std::sin(t)); };
+	ts.push_back(fms::benchmark("pipeline", [=]() {
+		fms::do_not_optimize(sum(apply(stage, apply(stage, pointer(px, n))))); }, n));
+	ts.push_back(fms::benchmark("pipeline_prefetch", [=]() {
+		fms::do_not_optimize(sum(apply(stage, prefetch(apply(stage, pointer(px, n)))))); }, n));
+	// producer thread feeding the consumer through a channel
+	ts.push_back(fms::benchmark("channel", [=]() {
+		channel<double> c;
+		std::thread p([=]() { c.push(pointer(px, n)); c.close(); });
+		fms::do_not_optimize(sum(c));
+		p.join(); }, n));
+	ts.push_back(fms::benchmark("channel_block", [=]() {
+		channel<double, wait::block> c;
+		std::thread p([=]() { c.push(pointer(px, n)); c.close(); });
+		fms::do_not_optimize(sum(c));
+		p.join(); }, n));
+
+	std::cout << "name,median,p99 (ns/element)\n";
+	for (const auto& t : ts) {
+		std::cout << t.name << ',' << t.median << ',' << t.p99 << '\n';
+	}
+	if (csv) {
+		std::ofstream os(csv);
+		fms::write_csv(os, ts);
+	}
+	if (json) {
+		std::ofstream os(json);
+		fms::write_json(os, ts);
+	}
+
+	return 0;
+}
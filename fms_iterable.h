@@ -1,11 +1,27 @@
 // fms_iterable.h - iterator with operator bool() const to detect the end
 #pragma once
-#include <execution>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
 #include <functional>
 #include <initializer_list>
+#include <limits>
+#include <memory>
 #include <numeric>
+#include <span>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 #include <vector>
+#include "fms_simd.h"
+
+// Empty members such as stateless functors take no space.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define FMS_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define FMS_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
 
 namespace fms::iterable {
 
@@ -32,6 +48,94 @@ namespace fms::iterable {
 		{ i.back() } -> std::same_as<I>;
 	};
 
+	// Remaining number of elements in O(1).
+	template <class I>
+	concept sized = input<I> && requires(const I i) {
+		{ i.size() } -> std::convertible_to<std::size_t>;
+	};
+
+	// Never exhausted.
+	template <class I>
+	concept unbounded = input<I> && requires {
+		requires I::infinite;
+	};
+
+	// Advance n elements in O(1). Never past the end.
+	template <class I>
+	concept advanceable = input<I> && requires(I i, typename I::difference_type n) {
+		{ i += n } -> std::same_as<I&>;
+	};
+
+	// O(1) i[n] and i += n.
+	template <class I>
+	concept random_access = advanceable<I> && requires(const I i, typename I::difference_type n) {
+		{ i[n] } -> std::convertible_to<typename I::value_type>;
+	};
+
+	// Copies traverse independently so a copy can read ahead.
+	// Sources sharing state between copies are never advanceable.
+	template <class I>
+	concept multi_pass = advanceable<I>;
+
+	// Number of increments from i to j in O(1).
+	template <class I>
+	concept distanced = input<I> && requires(const I i, const I j) {
+		{ i.distance(j) } -> std::convertible_to<typename I::difference_type>;
+	};
+
+	// Number of elements pulled per block by consumers.
+	inline constexpr std::size_t batch_size = 256;
+
+	// Copy up to s.size() elements into s and advance past them.
+	// Return the number copied. Less than s.size() only if the iterable is exhausted.
+	template <class I, class T = typename I::value_type>
+	concept batched = input<I, T> && requires(I i, std::span<T> s) {
+		{ i.next_batch(s) } -> std::same_as<std::size_t>;
+	};
+
+	// View of up to n elements of underlying storage and advance past them.
+	// Shorter than n only if the iterable is exhausted.
+	template <class I, class T = typename I::value_type>
+	concept contiguous = input<I, T> && requires(I i, std::size_t n) {
+		{ i.next_span(n) } -> std::same_as<std::span<const T>>;
+	};
+
+	// Block pull with fallback to one element at a time.
+	template <input I, class T = typename I::value_type>
+	constexpr std::size_t next_batch(I& i, std::span<std::type_identity_t<T>> s)
+	{
+		if constexpr (batched<I, T>) {
+			return i.next_batch(s);
+		}
+		else {
+			std::size_t n = 0;
+
+			while (n < s.size() && i) {
+				s[n++] = *i;
+				++i;
+			}
+
+			return n;
+		}
+	}
+
+	// Call f(std::span<const T>) on consecutive blocks of i.
+	template <input I, class F, class T = typename I::value_type>
+	constexpr void for_each_batch(I& i, F&& f)
+	{
+		std::array<T, batch_size> b;
+
+		for (;;) {
+			auto n = next_batch(i, std::span<T>(b));
+			if (n) {
+				f(std::span<const T>(b.data(), n));
+			}
+			if (n < b.size()) {
+				break;
+			}
+		}
+	}
+
 	//
 	// Stand alone functions
 	//
@@ -40,6 +144,32 @@ namespace fms::iterable {
 	template <input I, input J>
 	constexpr bool equal(I i, J j) noexcept
 	{
+		if constexpr (sized<I> && sized<J>) {
+			if (i.size() != j.size()) {
+				return false;
+			}
+		}
+		if constexpr (batched<I> && batched<J>) {
+			std::array<typename I::value_type, batch_size> a;
+			std::array<typename J::value_type, batch_size> b;
+
+			for (;;) {
+				auto m = i.next_batch(std::span(a));
+				auto n = j.next_batch(std::span(b));
+				if (m != n) {
+					return false;
+				}
+				for (std::size_t k = 0; k < n; ++k) {
+					if (a[k] != b[k]) {
+						return false;
+					}
+				}
+				if (n < batch_size) {
+					return true;
+				}
+			}
+		}
+
 		while (i && j) {
 			if (*i++ != *j++) {
 				return false;
@@ -65,8 +195,8 @@ namespace fms::iterable {
 	template <input I>
 	constexpr std::size_t length(I i, std::size_t n = 0) noexcept
 	{
-		if constexpr (has_end<I>) {
-			return n + std::distance(i, i.end());
+		if constexpr (sized<I>) {
+			return n + i.size();
 		}
 
 		while (i) {
@@ -81,10 +211,20 @@ namespace fms::iterable {
 	template <input I>
 	constexpr I drop(I i, std::size_t n) noexcept
 	{
-		using category = typename I::iterator_category;
-
-		if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category>) {
-			std::advance(i, std::min(n, length(i)));
+		if constexpr (advanceable<I>) {
+			using D = typename I::difference_type;
+			// a cast of n past the maximum would be negative
+			if constexpr (sized<I>) {
+				n = std::min(n, static_cast<std::size_t>(i.size()));
+			}
+			n = std::min(n, static_cast<std::size_t>(std::numeric_limits<D>::max()));
+			i += static_cast<D>(n);
+		}
+		else if constexpr (sized<I>) {
+			n = std::min(n, static_cast<std::size_t>(i.size()));
+			while (n--) {
+				++i;
+			}
 		}
 		else {
 			while (i && n) {
@@ -103,6 +243,13 @@ namespace fms::iterable {
 		if constexpr (has_back<I>) {
 			return i.back();
 		}
+		else if constexpr (sized<I> && advanceable<I>) {
+			if (auto n = static_cast<std::size_t>(i.size()); n > 1) {
+				i += static_cast<typename I::difference_type>(n - 1);
+			}
+
+			return i;
+		}
 
 		I _i(i);
 
@@ -130,6 +277,11 @@ namespace fms::iterable {
 		if constexpr (has_end<I>) {
 			return i.end();
 		}
+		else if constexpr (sized<I> && advanceable<I>) {
+			i += static_cast<typename I::difference_type>(i.size());
+
+			return i;
+		}
 
 		while (i) {
 			++i;
@@ -177,8 +329,6 @@ namespace fms::iterable {
 			return b == i.b && e == i.e;
 		}
 
-		// TODO: size() ???
-
 		constexpr explicit operator bool() const
 		{
 			return b != e;
@@ -203,6 +353,59 @@ namespace fms::iterable {
 
 			return i;
 		}
+
+		constexpr std::size_t size() const
+			requires std::random_access_iterator<I>
+		{
+			return e - b;
+		}
+		constexpr interval& operator+=(difference_type n)
+			requires std::random_access_iterator<I>
+		{
+			b += std::min(n, e - b);
+
+			return *this;
+		}
+		constexpr value_type operator[](difference_type n) const
+			requires std::random_access_iterator<I>
+		{
+			return b[n];
+		}
+		constexpr difference_type distance(const interval& i) const
+			requires std::random_access_iterator<I>
+		{
+			return i.b - b;
+		}
+
+		constexpr std::size_t next_batch(std::span<value_type> s)
+		{
+			if constexpr (std::random_access_iterator<I>) {
+				auto n = std::min<std::size_t>(e - b, s.size());
+				std::copy_n(b, n, s.data());
+				b += n;
+
+				return n;
+			}
+			else {
+				std::size_t n = 0;
+
+				while (n < s.size() && b != e) {
+					s[n++] = *b;
+					++b;
+				}
+
+				return n;
+			}
+		}
+		constexpr std::span<const value_type> next_span(std::size_t n)
+			requires std::contiguous_iterator<I> && std::same_as<T, std::iter_value_t<I>>
+		{
+			n = std::min<std::size_t>(e - b, n);
+			std::span<const value_type> s(std::to_address(b), n);
+			b += n;
+
+			return s;
+		}
 	};
 	template<class C> // container
 	constexpr auto make_interval(C& c)
@@ -210,58 +413,94 @@ namespace fms::iterable {
 		return interval(c.begin(), c.end());
 	}
 
-	// TODO: remove???
-	// Value type.
+	// Materialized values shared by copies. Only the cursor is copied.
+	// push_back and emplace_back copy the storage first if other copies share it.
 	template <class T>
 	class vector {
-		std::vector<T> v;
+		std::shared_ptr<std::vector<T>> v;
 		size_t i;
+
+		// storage this copy may modify
+		std::vector<T>& own()
+		{
+			if (v.use_count() > 1) {
+				v = std::make_shared<std::vector<T>>(*v);
+			}
+
+			return *v;
+		}
+		// Shared by moved from vectors so moves do not allocate.
+		static const std::shared_ptr<std::vector<T>>& none() noexcept
+		{
+			static const auto v_ = std::make_shared<std::vector<T>>();
+
+			return v_;
+		}
 	public:
 		using iterator_category = std::input_iterator_tag;
 		using value_type = T;
-		using reference = T&;
+		using reference = const T&;
 		using difference_type = typename std::vector<T>::difference_type;
 
 		vector()
-			: v{}, i(0)
+			: v(std::make_shared<std::vector<T>>()), i(0)
 		{  }
 		template<input I>
 			requires std::same_as<T, typename I::value_type>
 		vector(I i)
-			: v{}, i(0)
+			: vector()
 		{
-			while (i) {
-				v.push_back(*i);
-				++i;
+			auto& w = *v;
+			if constexpr (sized<I> && batched<I>) {
+				w.resize(i.size());
+				w.resize(i.next_batch(std::span(w)));
+			}
+			else if constexpr (sized<I>) {
+				w.reserve(i.size());
+				while (i) {
+					w.push_back(*i);
+					++i;
+				}
+			}
+			else if constexpr (batched<I>) {
+				for (;;) {
+					auto n = w.size();
+					w.resize(n + batch_size);
+					auto m = i.next_batch(std::span(w.data() + n, batch_size));
+					w.resize(n + m);
+					if (m < batch_size) {
+						break;
+					}
+				}
+			}
+			else {
+				while (i) {
+					w.push_back(*i);
+					++i;
+				}
 			}
 		}
 		vector(std::size_t n, const T* pt)
-			: v(pt, pt + n), i(0)
+			: v(std::make_shared<std::vector<T>>(pt, pt + n)), i(0)
+		{ }
+		explicit vector(std::vector<T>&& v_)
+			: v(std::make_shared<std::vector<T>>(std::move(v_))), i(0)
 		{ }
 		// E.g., vector({1,2,3})
 		vector(const std::initializer_list<T>& i)
-			: v(i), i(0)
-		{ }
-		vector(const vector& v_)
-			: v(v_.v), i(v_.i)
+			: v(std::make_shared<std::vector<T>>(i)), i(0)
 		{ }
-		vector(vector&& v_) noexcept
-			: v(std::move(v_.v)), i(v_.i)
+		vector(const vector&) = default;
+		// The source is left empty, not null.
+		vector(vector&& _v) noexcept
+			: v(std::exchange(_v.v, none())), i(std::exchange(_v.i, 0))
 		{ }
-		vector& operator=(const vector& v_)
-		{
-			if (this != &v_) {
-				v = v_.v;
-				i = v_.i;
-			}
-
-			return *this;
-		}
-		vector& operator=(vector&& v_) noexcept
+		vector& operator=(const vector&) = default;
+		vector& operator=(vector&& _v) noexcept
 		{
-			if (this != &v_) {
-				v = std::move(v_.v);
-				i = v_.i;
+			if (this != &_v) {
+				v = std::exchange(_v.v, none());
+				i = std::exchange(_v.i, 0);
 			}
 
 			return *this;
@@ -271,28 +510,26 @@ namespace fms::iterable {
 
 		auto begin() const
 		{
-			return v.begin();
+			return v->cbegin();
 		}
 		auto end() const
 		{
-			return v.end();
+			return v->cend();
 		}
 
-		// TODO: make more efficient
-		// same container???
-		bool operator==(const vector& _v) const = default;
-
-		explicit operator bool() const
+		// same storage and position
+		bool operator==(const vector& _v) const
 		{
-			return i < v.size();
+			return v == _v.v && i == _v.i;
 		}
-		value_type operator*() const
+
+		explicit operator bool() const
 		{
-			return v[i];
+			return i < v->size();
 		}
-		reference operator*() 
+		reference operator*() const
 		{
-			return v[i];
+			return (*v)[i];
 		}
 		vector& operator++()
 		{
@@ -311,6 +548,42 @@ namespace fms::iterable {
 			return _v;
 		}
 
+		std::size_t size() const
+		{
+			return v->size() - i;
+		}
+		vector& operator+=(difference_type n)
+		{
+			i += std::min(static_cast<std::size_t>(n), v->size() - i);
+
+			return *this;
+		}
+		reference operator[](difference_type n) const
+		{
+			return (*v)[i + n];
+		}
+		difference_type distance(const vector& _v) const
+		{
+			return static_cast<difference_type>(_v.i) - static_cast<difference_type>(i);
+		}
+
+		std::size_t next_batch(std::span<value_type> s)
+		{
+			auto n = std::min(v->size() - i, s.size());
+			std::copy_n(v->data() + i, n, s.data());
+			i += n;
+
+			return n;
+		}
+		std::span<const value_type> next_span(std::size_t n)
+		{
+			n = std::min(v->size() - i, n);
+			std::span<const value_type> s(v->data() + i, n);
+			i += n;
+
+			return s;
+		}
+
 		// Multi-pass
 		vector& reset(size_t i_ = 0)
 		{
@@ -323,20 +596,20 @@ namespace fms::iterable {
 
 		vector& push_back(const T& t)
 		{
-			v.push_back(t);
+			own().push_back(t);
 
 			return *this;
 		}
 		vector& push_back(T&& t)
 		{
-			v.push_back(t);
+			own().push_back(std::move(t));
 
 			return *this;
 		}
 		template <class... Args>
 		vector& emplace_back(Args&&... args)
 		{
-			v.emplace_back(args...);
+			own().emplace_back(std::forward<Args>(args)...);
 
 			return *this;
 		}
@@ -348,6 +621,213 @@ namespace fms::iterable {
 		return vector<T>(i);
 	}
 
+	// Lazily cache values of i in chunks shared by copies.
+	// Each value is computed once, on first access by any copy.
+	// Copies are not safe to use from different threads.
+	template <input I, class T = typename I::value_type>
+	class memoize {
+		static constexpr std::size_t shift = 10;
+		static constexpr std::size_t chunk = std::size_t(1) << shift;
+
+		struct cache {
+			I i; // next value to compute
+			std::vector<std::unique_ptr<T[]>> chunks;
+			std::size_t n; // values computed
+
+			// Compute values until k is cached or i is done.
+			bool fill(std::size_t k)
+			{
+				while (n <= k) {
+					if (!i) {
+						return false;
+					}
+					if ((n >> shift) == chunks.size()) {
+						chunks.push_back(std::make_unique<T[]>(chunk));
+					}
+					at(n) = *i;
+					++i;
+					++n;
+				}
+
+				return true;
+			}
+			T& at(std::size_t k) const
+			{
+				return chunks[k >> shift][k & (chunk - 1)];
+			}
+		};
+		std::shared_ptr<cache> c;
+		std::size_t k; // position of this copy
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using reference = const T&;
+		using difference_type = std::ptrdiff_t;
+		static constexpr bool infinite = unbounded<I>;
+
+		memoize(I i)
+			: c(std::make_shared<cache>(cache{ i, {}, 0 })), k(0)
+		{ }
+
+		// same cache and position
+		bool operator==(const memoize& m) const
+		{
+			return c == m.c && k == m.k;
+		}
+
+		// Number of values cached so far.
+		std::size_t cached() const noexcept
+		{
+			return c->n;
+		}
+
+		explicit operator bool() const
+		{
+			return k < c->n || c->fill(k);
+		}
+		reference operator*() const
+		{
+			c->fill(k);
+
+			return c->at(k);
+		}
+		memoize& operator++()
+		{
+			if (operator bool()) {
+				++k;
+			}
+
+			return *this;
+		}
+		memoize operator++(int)
+		{
+			auto m{ *this };
+
+			operator++();
+
+			return m;
+		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return c->n - k + c->i.size();
+		}
+
+		std::size_t next_batch(std::span<value_type> s)
+		{
+			if (s.empty()) {
+				return 0;
+			}
+			c->fill(k + s.size() - 1);
+			std::size_t m = 0;
+			while (m < s.size() && k < c->n) {
+				// copy the cached run in this chunk
+				auto l = std::min({ s.size() - m, c->n - k, chunk - (k & (chunk - 1)) });
+				std::copy_n(&c->at(k), l, s.data() + m);
+				k += l;
+				m += l;
+			}
+
+			return m;
+		}
+	};
+
+	// Compute *i at most once per element no matter how often it is dereferenced.
+	template <input I, class T = typename I::value_type>
+	class cached {
+		I i;
+		mutable T t;
+		mutable bool loaded;
+
+		void load() const
+		{
+			if (!loaded && i) {
+				t = *i;
+				loaded = true;
+			}
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using reference = const T&;
+		using difference_type = typename I::difference_type;
+
+		static constexpr bool infinite = unbounded<I>;
+
+		cached(const I& i)
+			: i(i), t{}, loaded(false)
+		{ }
+		cached(I&& i)
+			: i(std::move(i)), t{}, loaded(false)
+		{ }
+		// Load before copying so *i++ computes the element once.
+		cached(const cached& c)
+			: i(c.i), t((c.load(), c.t)), loaded(c.loaded)
+		{ }
+		cached(cached&&) = default;
+		cached& operator=(const cached&) = default;
+		cached& operator=(cached&&) = default;
+		~cached() = default;
+
+		bool operator==(const cached& c) const
+		{
+			return i == c.i;
+		}
+
+		explicit operator bool() const
+		{
+			return i.operator bool();
+		}
+		reference operator*() const
+		{
+			load();
+
+			return t;
+		}
+		cached& operator++()
+		{
+			++i;
+			loaded = false;
+
+			return *this;
+		}
+		cached operator++(int)
+		{
+			auto c{ *this };
+
+			operator++();
+
+			return c;
+		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return i.size();
+		}
+
+		std::size_t next_batch(std::span<value_type> s)
+			requires batched<I, T>
+		{
+			if (!loaded || s.empty()) {
+				return i.next_batch(s);
+			}
+			s[0] = t;
+			operator++();
+
+			return 1 + i.next_batch(s.subspan(1));
+		}
+	};
+
+	// Dereference calls a user function. Specialized after each such adaptor.
+	template <class I>
+	inline constexpr bool is_computed_v = false;
+
+	// Adaptors that read the head of I more than once store cached_t<I>.
+	template <class I>
+	using cached_t = std::conditional_t<is_computed_v<I>, cached<I>, I>;
+
 	// Iterable with no elements.
 	template<class T>
 	struct empty {
@@ -376,6 +856,11 @@ namespace fms::iterable {
 		{
 			return empty{};
 		}
+
+		std::size_t size() const noexcept
+		{
+			return 0;
+		}
 	};
 
 	// Constant iterable: {c, c, c, ...}
@@ -388,6 +873,7 @@ namespace fms::iterable {
 		using value_type = T;
 		using reference = T&;
 		using difference_type = std::ptrdiff_t;
+		static constexpr bool infinite = true;
 
 		constant(T c = 0) noexcept
 			: c(c)
@@ -418,10 +904,32 @@ namespace fms::iterable {
 		{
 			return constant(c);
 		}
-	};
-
-	// t, t + 1, t + 2, ...
-	template <class T>
+		constant& operator+=(difference_type) noexcept
+		{
+			return *this;
+		}
+		value_type operator[](difference_type) const noexcept
+		{
+			return c;
+		}
+
+		std::size_t next_batch(std::span<value_type> s) noexcept
+		{
+			std::fill(s.begin(), s.end(), c);
+
+			return s.size();
+		}
+	};
+
+	template <class I>
+	struct is_constant : std::false_type {};
+	template <class T>
+	struct is_constant<constant<T>> : std::true_type {};
+	template <class I>
+	inline constexpr bool is_constant_v = is_constant<I>::value;
+
+	// t, t + 1, t + 2, ...
+	template <class T>
 	class iota {
 		T t;
 
@@ -429,6 +937,7 @@ namespace fms::iterable {
 		using iterator_category = std::input_iterator_tag;
 		using value_type = T;
 		using difference_type = std::ptrdiff_t;
+		static constexpr bool infinite = true;
 
 		iota(T t = 0) noexcept
 			: t(t)
@@ -458,6 +967,30 @@ namespace fms::iterable {
 
 			return i;
 		}
+		iota& operator+=(difference_type n) noexcept
+		{
+			t += static_cast<T>(n);
+
+			return *this;
+		}
+		value_type operator[](difference_type n) const noexcept
+		{
+			return t + static_cast<T>(n);
+		}
+		difference_type distance(const iota& i) const noexcept
+		{
+			return static_cast<difference_type>(i.t - t);
+		}
+
+		std::size_t next_batch(std::span<value_type> s) noexcept
+		{
+			for (auto& t_ : s) {
+				t_ = t;
+				++t;
+			}
+
+			return s.size();
+		}
 	};
 
 	// tn, tn*t, tn*t*t, ...
@@ -469,6 +1002,7 @@ namespace fms::iterable {
 		using iterator_category = std::input_iterator_tag;
 		using value_type = T;
 		using difference_type = std::ptrdiff_t;
+		static constexpr bool infinite = true;
 
 		power(T t, T tn = 1)
 			: t(t), tn(tn)
@@ -498,6 +1032,47 @@ namespace fms::iterable {
 
 			return p;
 		}
+
+		// t^n
+		static T pow(T t, difference_type n) noexcept
+		{
+			if constexpr (std::is_floating_point_v<T>) {
+				return std::pow(t, static_cast<T>(n));
+			}
+			else { // repeated squaring
+				T tn = 1;
+
+				while (n > 0) {
+					if (n & 1) {
+						tn *= t;
+					}
+					t *= t;
+					n >>= 1;
+				}
+
+				return tn;
+			}
+		}
+		power& operator+=(difference_type n) noexcept
+		{
+			tn *= pow(t, n);
+
+			return *this;
+		}
+		value_type operator[](difference_type n) const noexcept
+		{
+			return tn * pow(t, n);
+		}
+
+		std::size_t next_batch(std::span<value_type> s) noexcept
+		{
+			for (auto& t_ : s) {
+				t_ = tn;
+				tn *= t;
+			}
+
+			return s.size();
+		}
 	};
 
 	// 1, 1, 2, 6, 24, ...
@@ -509,6 +1084,7 @@ namespace fms::iterable {
 		using iterator_category = std::input_iterator_tag;
 		using value_type = T;
 		using difference_type = std::ptrdiff_t;
+		static constexpr bool infinite = true;
 
 		factorial(T t = 1)
 			: t(t), n(1)
@@ -538,6 +1114,16 @@ namespace fms::iterable {
 
 			return f;
 		}
+
+		std::size_t next_batch(std::span<value_type> s) noexcept
+		{
+			for (auto& t_ : s) {
+				t_ = t;
+				t *= n++;
+			}
+
+			return s.size();
+		}
 	};
 
 	// 1, n, n*(n-1)/2, ..., 1
@@ -582,6 +1168,42 @@ namespace fms::iterable {
 
 			return c;
 		}
+
+		std::size_t size() const noexcept
+		{
+			return k <= n ? static_cast<std::size_t>(n - k + 1) : 0;
+		}
+
+		// n!/(k! (n - k)!) in O(min(k, n - k))
+		static T binomial(T n, T k) noexcept
+		{
+			if (k > n) {
+				return 0;
+			}
+			k = std::min(k, n - k);
+
+			T nk = 1;
+			for (T j = 1; j <= k; ++j) {
+				nk = nk * (n - k + j) / j;
+			}
+
+			return nk;
+		}
+		choose& operator+=(difference_type m) noexcept
+		{
+			k = std::min<T>(k + static_cast<T>(m), n + 1);
+			nk = binomial(n, k);
+
+			return *this;
+		}
+		value_type operator[](difference_type m) const noexcept
+		{
+			return binomial(n, k + static_cast<T>(m));
+		}
+		difference_type distance(const choose& c) const noexcept
+		{
+			return static_cast<difference_type>(c.k) - static_cast<difference_type>(k);
+		}
 	};
 
 	// Unsafe counted pointer interface with std::span semantics.
@@ -591,7 +1213,7 @@ namespace fms::iterable {
 		size_t n;
 	public:
 		using iterator_category = std::input_iterator_tag;
-		using value_type = T;
+		using value_type = std::remove_cv_t<T>;
 		using reference = T&;
 		using difference_type = std::ptrdiff_t;
 
@@ -640,6 +1262,46 @@ namespace fms::iterable {
 
 			return _p;
 		}
+
+		std::size_t size() const noexcept
+		{
+			return n;
+		}
+		pointer& operator+=(difference_type k) noexcept
+		{
+			auto k_ = std::min(static_cast<std::size_t>(k), n);
+			p += k_;
+			n -= k_;
+
+			return *this;
+		}
+		value_type operator[](difference_type k) const noexcept
+		{
+			return p[k];
+		}
+		difference_type distance(const pointer& _p) const noexcept
+		{
+			return _p.p - p;
+		}
+
+		std::size_t next_batch(std::span<value_type> s) noexcept
+		{
+			auto k = std::min(n, s.size());
+			std::copy_n(p, k, s.data());
+			p += k;
+			n -= k;
+
+			return k;
+		}
+		std::span<const value_type> next_span(std::size_t k) noexcept
+		{
+			k = std::min(n, k);
+			std::span<const value_type> s(p, k);
+			p += k;
+			n -= k;
+
+			return s;
+		}
 	};
 
 	// Terminate on 0 value.
@@ -649,7 +1311,7 @@ namespace fms::iterable {
 
 	public:
 		using iterator_category = std::input_iterator_tag;
-		using value_type = T;
+		using value_type = std::remove_cv_t<T>;
 		using reference = T&;
 		using difference_type = std::ptrdiff_t;
 
@@ -686,6 +1348,24 @@ namespace fms::iterable {
 
 			return _p;
 		}
+
+		std::span<const value_type> next_span(std::size_t n) noexcept
+		{
+			std::size_t k = 0;
+
+			if constexpr (std::is_same_v<value_type, char>) {
+				k = std::min(n, std::strlen(p));
+			}
+			else {
+				while (k < n && p[k]) {
+					++k;
+				}
+			}
+			std::span<const value_type> s(p, k);
+			p += k;
+
+			return s;
+		}
 	};
 
 	// Iterable having exactly one element. {t}
@@ -731,6 +1411,11 @@ namespace fms::iterable {
 
 			return o;
 		}
+
+		std::size_t size() const noexcept
+		{
+			return b;
+		}
 	};
 
 	// Repeat iterable
@@ -742,6 +1427,7 @@ namespace fms::iterable {
 		using value_type = typename I::value_type;
 		using reference = typename I::reference;
 		using difference_type = typename I::difference_type;
+		static constexpr bool infinite = true;
 
 		repeat(I i) noexcept
 			: i0(i), i(i)
@@ -763,10 +1449,8 @@ namespace fms::iterable {
 		}
 		repeat& operator++() noexcept
 		{
-			if (i) {
-				++i;
-			}
-			else {
+			++i;
+			if (!i) {
 				i = i0;
 			}
 
@@ -839,6 +1523,55 @@ namespace fms::iterable {
 
 			return t;
 		}
+
+		std::size_t size() const
+			requires sized<I> || unbounded<I>
+		{
+			if constexpr (sized<I>) {
+				return std::min<std::size_t>(n, i.size());
+			}
+			else {
+				return n;
+			}
+		}
+		// Templates so nothing is formed when difference_type is void.
+		template <std::convertible_to<difference_type> D>
+			requires advanceable<I>
+		take& operator+=(D k)
+		{
+			auto m = std::min<difference_type>(k, n);
+			i += m;
+			n -= m;
+
+			return *this;
+		}
+		template <std::convertible_to<difference_type> D>
+			requires random_access<I>
+		value_type operator[](D k) const
+		{
+			return i[k];
+		}
+		difference_type distance(const take& t) const
+		{
+			return static_cast<difference_type>(n) - static_cast<difference_type>(t.n);
+		}
+
+		std::size_t next_batch(std::span<value_type> s)
+			requires batched<I, T>
+		{
+			auto m = i.next_batch(s.first(std::min(n, s.size())));
+			n -= m;
+
+			return m;
+		}
+		std::span<const value_type> next_span(std::size_t k)
+			requires contiguous<I, T>
+		{
+			auto s = i.next_span(std::min(n, k));
+			n -= s.size();
+
+			return s;
+		}
 	};
 
 	// Assumes lifetime of a[N].
@@ -895,46 +1628,263 @@ namespace fms::iterable {
 
 			return c;
 		}
+
+		std::size_t size() const
+			requires sized<I0> && sized<I1>
+		{
+			return i0.size() + i1.size();
+		}
+		std::size_t next_batch(std::span<value_type> s)
+			requires std::same_as<typename I0::value_type, T> && std::same_as<typename I1::value_type, T>
+		{
+			auto n = i0 ? iterable::next_batch(i0, s) : 0;
+			if (n < s.size()) {
+				n += iterable::next_batch(i1, s.subspan(n));
+			}
+
+			return n;
+		}
+	};
+
+	// i[0] then i[1] then ...
+	template <input I, class T = typename I::value_type>
+	class concatenate_vector {
+		std::vector<I> is;
+		std::size_t k; // active part
+		std::size_t r; // remaining elements if I is sized
+
+		void skip()
+		{
+			while (k < is.size() && !is[k]) {
+				++k;
+			}
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using difference_type = typename I::difference_type;
+
+		concatenate_vector(std::vector<I> is_)
+			: is(std::move(is_)), k(0), r(0)
+		{
+			if constexpr (sized<I>) {
+				for (const auto& i : is) {
+					r += i.size();
+				}
+			}
+			skip();
+		}
+
+		bool operator==(const concatenate_vector& c) const = default;
+
+		explicit operator bool() const
+		{
+			return k < is.size();
+		}
+		value_type operator*() const
+		{
+			return *is[k];
+		}
+		concatenate_vector& operator++()
+		{
+			if (k < is.size()) {
+				++is[k];
+				if constexpr (sized<I>) {
+					--r;
+				}
+				skip();
+			}
+
+			return *this;
+		}
+		concatenate_vector operator++(int)
+		{
+			auto c{ *this };
+
+			operator++();
+
+			return c;
+		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return r;
+		}
+		std::size_t next_batch(std::span<value_type> s)
+			requires std::same_as<typename I::value_type, T>
+		{
+			std::size_t n = 0;
+
+			while (n < s.size() && k < is.size()) {
+				n += iterable::next_batch(is[k], s.subspan(n));
+				skip();
+			}
+			if constexpr (sized<I>) {
+				r -= n;
+			}
+
+			return n;
+		}
+	};
+
+	// Is[0] then Is[1] then ... using the index of the active part.
+	template <input... Is>
+	class concatenate_tuple {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::common_type_t<typename Is::value_type...>;
+		using difference_type = std::ptrdiff_t;
+	private:
+		using tuple = std::tuple<Is...>;
+		using index = std::index_sequence_for<Is...>;
+		static constexpr std::size_t N = sizeof...(Is);
+
+		tuple is;
+		std::size_t k; // active part
+
+		template <std::size_t J>
+		static bool live(const concatenate_tuple& c)
+		{
+			return bool(std::get<J>(c.is));
+		}
+		template <std::size_t J>
+		static auto star(const concatenate_tuple& c)
+		{
+			return static_cast<value_type>(*std::get<J>(c.is));
+		}
+		template <std::size_t J>
+		static void incr(concatenate_tuple& c)
+		{
+			++std::get<J>(c.is);
+		}
+		template <std::size_t J>
+		static std::size_t batch(concatenate_tuple& c, std::span<value_type> s)
+		{
+			return iterable::next_batch(std::get<J>(c.is), s);
+		}
+
+		void skip()
+		{
+			static constexpr auto live = []<std::size_t... J>(std::index_sequence<J...>) {
+				return std::array<bool(*)(const concatenate_tuple&), N>{ &concatenate_tuple::live<J>... };
+			}(index{});
+
+			while (k < N && !live[k](*this)) {
+				++k;
+			}
+		}
+	public:
+		concatenate_tuple(const Is&... is_)
+			: is(is_...), k(0)
+		{
+			skip();
+		}
+
+		bool operator==(const concatenate_tuple& c) const = default;
+
+		explicit operator bool() const
+		{
+			return k < N;
+		}
+		value_type operator*() const
+		{
+			// jump table indexed by the active part
+			static constexpr auto star = []<std::size_t... J>(std::index_sequence<J...>) {
+				return std::array<value_type(*)(const concatenate_tuple&), N>{ &concatenate_tuple::star<J>... };
+			}(index{});
+
+			return star[k](*this);
+		}
+		concatenate_tuple& operator++()
+		{
+			static constexpr auto incr = []<std::size_t... J>(std::index_sequence<J...>) {
+				return std::array<void(*)(concatenate_tuple&), N>{ &concatenate_tuple::incr<J>... };
+			}(index{});
+
+			if (k < N) {
+				incr[k](*this);
+				skip();
+			}
+
+			return *this;
+		}
+		concatenate_tuple operator++(int)
+		{
+			auto c{ *this };
+
+			operator++();
+
+			return c;
+		}
+
+		// Exhausted parts have size 0.
+		std::size_t size() const
+			requires (sized<Is> && ...)
+		{
+			return std::apply([](const auto&... i) { return (std::size_t(i.size()) + ...); }, is);
+		}
+		std::size_t next_batch(std::span<value_type> s)
+			requires (std::same_as<typename Is::value_type, value_type> && ...)
+		{
+			static constexpr auto batch = []<std::size_t... J>(std::index_sequence<J...>) {
+				return std::array<std::size_t(*)(concatenate_tuple&, std::span<value_type>), N>{ &concatenate_tuple::batch<J>... };
+			}(index{});
+			std::size_t n = 0;
+
+			while (n < s.size() && k < N) {
+				n += batch[k](*this, s.subspan(n));
+				skip();
+			}
+
+			return n;
+		}
 	};
+
 	template<input I>
 	inline auto concatenate(I i)
 	{
 		return i;
 	}
+	template<input I0, input I1>
+	inline auto concatenate(I0 i0, I1 i1)
+	{
+		return concatenate2(i0, i1);
+	}
+	// O(1) dispatch per element for any number of parts.
 	template<input I, input ...Is>
+		requires (sizeof...(Is) > 1)
 	inline auto concatenate(I i, Is... is)
 	{
-		return concatenate2(i, concatenate(is...));
+		return concatenate_tuple(i, is...);
+	}
+	template<input I>
+	inline auto concatenate(std::vector<I> is)
+	{
+		return concatenate_vector<I>(std::move(is));
 	}
 
-	// Sorted i0 and i1 in order. Equivalent (!< and !>) elements are repeated.
+	// Sorted i0 and i1 in order. Equivalent (!< and !>) elements are repeated, i0 first.
 	template <input I0, input I1, class T = std::common_type_t<typename I0::value_type, typename I1::value_type>>
 	class merge2 {
-		I0 i0;
-		I1 i1;
+		cached_t<I0> i0;
+		cached_t<I1> i1;
 		bool _0; // true use i0, false use i1
+
+		// Compare heads once per element.
+		void choose()
+		{
+			_0 = i0 && (!i1 || !(*i1 < *i0));
+		}
 	public:
 		using iterator_category = std::input_iterator_tag;
 		using value_type = T;
-		using difference_type = std::common_type_t<typename I0::difference_type, typename I0::difference_type>;
+		using difference_type = std::common_type_t<typename I0::difference_type, typename I1::difference_type>;
 
 		merge2(const I0& i0, const I1& i1)
 			: i0(i0), i1(i1)
 		{
-			if (i0 && i1) {
-				if (*i1 < *i0) {
-					_0 = false;
-				}
-				else { // less or equivalent
-					_0 = true;
-				}
-			}
-			else if (i0) {
-				_0 = true;
-			}
-			else {
-				_0 = false;
-			}
+			choose();
 		}
 
 		bool operator==(const merge2& i) const = default;
@@ -945,54 +1895,225 @@ namespace fms::iterable {
 		}
 		value_type operator*() const
 		{
-			if (i0 && i1) {
-				if (*i0 < *i1) {
-					return *i0;
-				}
-				else if (*i1 < *i0) {
-					return *i1;
-				}
-				else {
-					return _0 ? *i0 : *i1;
-				}
+			return _0 ? *i0 : *i1;
+		}
+		merge2& operator++()
+		{
+			if (_0) {
+				++i0;
 			}
+			else if (i1) {
+				++i1;
+			}
+			choose();
 
-			return i0 ? *i0 : *i1;
+			return *this;
 		}
-		merge2& operator++()
+		merge2 operator++(int) noexcept
 		{
-			if (i0 && i1) {
-				if (*i0 < *i1) {
-					++i0;
-				}
-				else if (*i1 < *i0) {
-					++i1;
+			auto m{ *this };
+
+			operator++();
+
+			return m;
+		}
+	};
+
+	// Tournament over the cached heads of k sorted inputs.
+	// Internal node n < k holds the loser of its subtree, leaf j is at k + j.
+	// Ties go to the input with the smaller index so merges are stable.
+	template <class T>
+	class loser_tree {
+		std::vector<T> head;
+		std::vector<char> live;
+		std::vector<std::size_t> loser;
+		std::size_t w; // winner
+
+		bool beats(std::size_t a, std::size_t b) const
+		{
+			if (!live[a] || !live[b]) {
+				return live[a] && !live[b];
+			}
+
+			return head[a] < head[b] || (!(head[b] < head[a]) && a < b);
+		}
+	public:
+		loser_tree(std::size_t k = 0)
+			: head(k), live(k, false), loser(k), w(0)
+		{ }
+
+		bool operator==(const loser_tree&) const = default;
+
+		std::size_t size() const
+		{
+			return head.size();
+		}
+		// Index of the smallest head.
+		std::size_t winner() const
+		{
+			return w;
+		}
+		bool operator()() const
+		{
+			return w < live.size() && live[w];
+		}
+		const T& top() const
+		{
+			return head[w];
+		}
+		// Set the head of input j. Call build or replay after.
+		void set(std::size_t j, bool b, const T& t)
+		{
+			live[j] = b;
+			if (b) {
+				head[j] = t;
+			}
+		}
+		// Play all matches in O(k).
+		void build()
+		{
+			auto k = size();
+			if (k <= 1) {
+				w = 0;
+
+				return;
+			}
+
+			std::vector<std::size_t> win(2 * k);
+			for (std::size_t j = 0; j < k; ++j) {
+				win[k + j] = j;
+			}
+			for (auto n = k - 1; n > 0; --n) {
+				auto a = win[2 * n], b = win[2 * n + 1];
+				if (beats(a, b)) {
+					win[n] = a;
+					loser[n] = b;
 				}
-				else { // equivalent
-					if (_0) {
-						++i0;
-					}
-					else {
-						++i1;
-					}
-					_0 = !_0; // switch
+				else {
+					win[n] = b;
+					loser[n] = a;
 				}
 			}
-			else {
-				if (i0) {
-					++i0;
-					_0 = true;
-				}
-				else if (i1) {
-					++i1;
-					_0 = false;
+			w = win[1];
+		}
+		// Replay the path from the winner after its head changed in O(log k).
+		void replay()
+		{
+			auto j = w;
+
+			for (auto n = (size() + j) / 2; n > 0; n /= 2) {
+				if (beats(loser[n], j)) {
+					std::swap(loser[n], j);
 				}
 			}
-	
+			w = j;
+		}
+	};
+
+	// Sorted inputs of the same type in order using a loser tree.
+	template <input I, class T = typename I::value_type>
+	class merge_vector {
+		std::vector<I> is;
+		loser_tree<T> t;
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using difference_type = typename I::difference_type;
+
+		merge_vector(std::vector<I> is_)
+			: is(std::move(is_)), t(is.size())
+		{
+			for (std::size_t j = 0; j < is.size(); ++j) {
+				t.set(j, bool(is[j]), is[j] ? T(*is[j]) : T{});
+			}
+			t.build();
+		}
+
+		bool operator==(const merge_vector& m) const = default;
+
+		explicit operator bool() const
+		{
+			return t();
+		}
+		value_type operator*() const
+		{
+			return t.top();
+		}
+		merge_vector& operator++()
+		{
+			if (t()) {
+				auto& i = is[t.winner()];
+				++i;
+				t.set(t.winner(), bool(i), i ? T(*i) : T{});
+				t.replay();
+			}
+
+			return *this;
+		}
+		merge_vector operator++(int)
+		{
+			auto m{ *this };
+
+			operator++();
+
+			return m;
+		}
+	};
+
+	// Sorted inputs of possibly different types in order using a loser tree.
+	template <input... Is>
+	class merge_tuple {
+		using tuple = std::tuple<Is...>;
+		using index = std::index_sequence_for<Is...>;
+
+		tuple is;
+		loser_tree<std::common_type_t<typename Is::value_type...>> t;
+
+		template <std::size_t J>
+		static void next(merge_tuple& m)
+		{
+			auto& i = std::get<J>(m.is);
+			++i;
+			m.t.set(J, bool(i), i ? value_type(*i) : value_type{});
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::common_type_t<typename Is::value_type...>;
+		using difference_type = std::ptrdiff_t;
+
+		merge_tuple(const Is&... is_)
+			: is(is_...), t(sizeof...(Is))
+		{
+			[this]<std::size_t... J>(std::index_sequence<J...>) {
+				(t.set(J, bool(std::get<J>(is)), std::get<J>(is) ? value_type(*std::get<J>(is)) : value_type{}), ...);
+			}(index{});
+			t.build();
+		}
+
+		bool operator==(const merge_tuple& m) const = default;
+
+		explicit operator bool() const
+		{
+			return t();
+		}
+		value_type operator*() const
+		{
+			return t.top();
+		}
+		merge_tuple& operator++()
+		{
+			if (t()) {
+				// jump table indexed by the winning input
+				static constexpr auto advance = []<std::size_t... J>(std::index_sequence<J...>) {
+					return std::array<void(*)(merge_tuple&), sizeof...(J)>{ &next<J>... };
+				}(index{});
+				advance[t.winner()](*this);
+				t.replay();
+			}
 
 			return *this;
 		}
-		merge2 operator++(int) noexcept
+		merge_tuple operator++(int)
 		{
 			auto m{ *this };
 
@@ -1001,25 +2122,39 @@ namespace fms::iterable {
 			return m;
 		}
 	};
+
 	template<input I>
 	inline auto merge(I i)
 	{
 		return i;
 	}
+	template<input I0, input I1>
+	inline auto merge(I0 i0, I1 i1)
+	{
+		return merge2(i0, i1);
+	}
+	// O(log k) comparisons per element for k inputs.
 	template<input I, input ...Is>
+		requires (sizeof...(Is) > 1)
 	inline auto merge(I i, Is... is)
 	{
-		return merge2(i, merge(is...));
+		return merge_tuple(i, is...);
+	}
+	template<input I>
+	inline auto merge(std::vector<I> is)
+	{
+		return merge_vector<I>(std::move(is));
 	}
 
 	// f(), ...
 	template <class F, class T = std::invoke_result_t<F>>
 	class call {
-		F f;
+		FMS_NO_UNIQUE_ADDRESS F f;
 	public:
 		using iterator_category = std::input_iterator_tag;
 		using value_type = T;
 		using difference_type = void;
+		static constexpr bool infinite = true;
 
 		call(F&& f)
 			: f(f)
@@ -1039,12 +2174,31 @@ namespace fms::iterable {
 		}
 	};
 
+	template <class F, class T>
+	inline constexpr bool is_computed_v<call<F, T>> = true;
+
+	// f(g(x))
+	template <class F, class G>
+	struct compose {
+		FMS_NO_UNIQUE_ADDRESS F f;
+		FMS_NO_UNIQUE_ADDRESS G g;
+
+		template <class X>
+		auto operator()(X&& x) const
+		{
+			return f(g(std::forward<X>(x)));
+		}
+	};
+
 	// Apply a function to elements of an iterable.
 	// f(*i), f(*++i), f(*++i), ...
 	template <class F, input I, class T = typename I::value_type, 
 		class U = std::invoke_result_t<F, T>>
 	class apply {
-		F f;
+		template <class F_, input I_, class T_, class U_>
+		friend class apply;
+
+		FMS_NO_UNIQUE_ADDRESS F f;
 		I i;
 	public:
 		using iterator_category = std::input_iterator_tag;
@@ -1054,10 +2208,16 @@ namespace fms::iterable {
 		apply(const F& f, const I& i)
 			: f(f), i(i)
 		{ }
+		// apply(f, apply(g, i)) is apply(compose(f, g), i)
+		template <class F_, class G, class T_, class U_>
+			requires std::same_as<F, compose<F_, G>>
+		apply(const F_& f_, const apply<G, I, T_, U_>& a)
+			: f{ f_, a.f }, i(a.i)
+		{ }
 		apply(const apply& a)
 			: f(a.f), i(a.i)
 		{ }
-		apply(apply&& a)
+		apply(apply&& a) noexcept(std::is_nothrow_copy_constructible_v<F> && std::is_nothrow_move_constructible_v<I>)
 			: f(a.f), i(std::move(a.i))
 		{ }
 		apply& operator=(const apply& a)
@@ -1108,15 +2268,77 @@ namespace fms::iterable {
 
 			return a;
 		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return i.size();
+		}
+		template <std::convertible_to<difference_type> D>
+			requires advanceable<I>
+		apply& operator+=(D n)
+		{
+			i += n;
+
+			return *this;
+		}
+		template <std::convertible_to<difference_type> D>
+			requires random_access<I>
+		value_type operator[](D n) const
+		{
+			return f(i[n]);
+		}
+		difference_type distance(const apply& a) const
+			requires distanced<I>
+		{
+			return i.distance(a.i);
+		}
+
+		std::size_t next_batch(std::span<value_type> s)
+			requires batched<I, T>
+		{
+			if constexpr (std::is_same_v<T, U>) { // in place
+				auto n = i.next_batch(s);
+				for (std::size_t k = 0; k < n; ++k) {
+					s[k] = f(s[k]);
+				}
+
+				return n;
+			}
+			else {
+				std::array<T, batch_size> b;
+				std::size_t n = 0;
+
+				while (n < s.size()) {
+					auto r = std::min(b.size(), s.size() - n);
+					auto m = i.next_batch(std::span(b.data(), r));
+					for (std::size_t k = 0; k < m; ++k) {
+						s[n + k] = f(b[k]);
+					}
+					n += m;
+					if (m < r) {
+						break;
+					}
+				}
+
+				return n;
+			}
+		}
 	};
 
+	template <class F, class G, input J, class T, class U>
+	apply(F, apply<G, J, T, U>) -> apply<compose<F, G>, J>;
+
+	template <class F, class I, class T, class U>
+	inline constexpr bool is_computed_v<apply<F, I, T, U>> = true;
+
 	// TODO: apply(f, *i0, *i1, ...), apply(f, {*++i0, *++i1, ...}), ...
 
 	// Apply a binary operation to elements of two iterable.
 	template <class BinOp, input I0, input I1, class T0 = typename I0::value_type, class T1 = typename I1::value_type, 
 		class T = std::invoke_result_t<BinOp, T0, T1>>
 	class binop {
-		BinOp op;
+		FMS_NO_UNIQUE_ADDRESS BinOp op;
 		I0 i0;
 		I1 i1;
 	public:
@@ -1133,7 +2355,8 @@ namespace fms::iterable {
 		binop(const binop& o)
 			: op(o.op), i0(o.i0), i1(o.i1)
 		{ }
-		binop(binop&& o) noexcept
+		binop(binop&& o) noexcept(std::is_nothrow_copy_constructible_v<BinOp>
+			&& std::is_nothrow_move_constructible_v<I0> && std::is_nothrow_move_constructible_v<I1>)
 			: op(o.op), i0(std::move(o.i0)), i1(std::move(o.i1))
 		{ }
 		binop& operator=(const binop& o)
@@ -1153,6 +2376,8 @@ namespace fms::iterable {
 				i0 = std::move(o.i0);
 				i1 = std::move(o.i1);
 			}
+
+			return *this;
 		}
 		~binop() { }
 
@@ -1184,13 +2409,167 @@ namespace fms::iterable {
 
 			return b;
 		}
+
+		// Unbounded sides do not limit the size.
+		std::size_t size() const
+			requires (sized<I0> || unbounded<I0>) && (sized<I1> || unbounded<I1>) && (sized<I0> || sized<I1>)
+		{
+			if constexpr (sized<I0> && sized<I1>) {
+				return std::min<std::size_t>(i0.size(), i1.size());
+			}
+			else if constexpr (sized<I0>) {
+				return i0.size();
+			}
+			else {
+				return i1.size();
+			}
+		}
+		binop& operator+=(difference_type n)
+			requires advanceable<I0> && advanceable<I1>
+		{
+			i0 += static_cast<typename I0::difference_type>(n);
+			i1 += static_cast<typename I1::difference_type>(n);
+
+			return *this;
+		}
+		value_type operator[](difference_type n) const
+			requires random_access<I0> && random_access<I1>
+		{
+			return op(i0[static_cast<typename I0::difference_type>(n)], i1[static_cast<typename I1::difference_type>(n)]);
+		}
+		difference_type distance(const binop& o) const
+			requires distanced<I0>
+		{
+			return i0.distance(o.i0);
+		}
+
+		std::size_t next_batch(std::span<value_type> s)
+			requires batched<I0, T0> && batched<I1, T1>
+		{
+			if constexpr (is_constant_v<I1> && std::same_as<T0, T>) {
+				return broadcast<false>(i0, T(*i1), s);
+			}
+			else if constexpr (is_constant_v<I0> && std::same_as<T1, T>) {
+				return broadcast<true>(i1, T(*i0), s);
+			}
+			else if constexpr (contiguous<I0, T> && contiguous<I1, T> && simd::elementwise<BinOp, T>) {
+				auto a = i0.next_span(s.size());
+				auto b = i1.next_span(s.size());
+				auto n = std::min(a.size(), b.size());
+				simd::transform(op, a.data(), b.data(), s.data(), n);
+
+				return n;
+			}
+
+			std::array<T0, batch_size> b0;
+			std::array<T1, batch_size> b1;
+			std::size_t n = 0;
+
+			while (n < s.size()) {
+				auto r = std::min(batch_size, s.size() - n);
+				auto m0 = i0.next_batch(std::span(b0.data(), r));
+				auto m1 = i1.next_batch(std::span(b1.data(), r));
+				auto m = std::min(m0, m1);
+				for (std::size_t k = 0; k < m; ++k) {
+					s[n + k] = op(b0[k], b1[k]);
+				}
+				n += m;
+				if (m < r) {
+					break;
+				}
+			}
+
+			return n;
+		}
+	private:
+		// One side is the constant c. Skip identities and broadcast c otherwise.
+		// c is only known at run time so this is checked once per batch, not at construction.
+		template <bool left, class J>
+		std::size_t broadcast(J& j, T c, std::span<value_type> s)
+		{
+			constexpr auto O = simd::op_of<BinOp, T>();
+			// x + -0.0 and x - +0.0 are x, but -0.0 + +0.0 is +0.0
+			constexpr bool fp = std::is_floating_point_v<T>;
+			const bool neg = [&c]() {
+				if constexpr (fp) {
+					return std::signbit(c);
+				}
+				else {
+					return false;
+				}
+			}();
+			const bool identity = (O == simd::op::add && c == T(0) && (!fp || neg))
+				|| (O == simd::op::sub && !left && c == T(0) && (!fp || !neg))
+				|| (O == simd::op::mul && c == T(1))
+				|| (O == simd::op::div && !left && c == T(1));
+			// x*0 is not 0 for floating point infinity and NaN.
+			const bool zero = std::is_integral_v<T> && O == simd::op::mul && c == T(0);
+
+			if constexpr (contiguous<J, T>) {
+				auto a = j.next_span(s.size());
+				if (identity) {
+					std::copy(a.begin(), a.end(), s.data());
+				}
+				else if (zero) {
+					std::fill_n(s.data(), a.size(), T(0));
+				}
+				else if constexpr (left) {
+					simd::transform(op, c, a.data(), s.data(), a.size());
+				}
+				else {
+					simd::transform(op, a.data(), c, s.data(), a.size());
+				}
+
+				return a.size();
+			}
+			else {
+				auto n = j.next_batch(s);
+				if (zero) {
+					std::fill_n(s.data(), n, T(0));
+				}
+				else if (!identity) {
+					if constexpr (left) {
+						simd::transform(op, c, s.data(), s.data(), n);
+					}
+					else {
+						simd::transform(op, s.data(), c, s.data(), n);
+					}
+				}
+
+				return n;
+			}
+		}
 	};
 
+	template <class BinOp, class I0, class I1, class T0, class T1, class T>
+	inline constexpr bool is_computed_v<binop<BinOp, I0, I1, T0, T1, T>> = true;
+
+	// Predicate op(u, t) for a fixed t.
+	template <class Op, class T>
+	struct compare {
+		using op = Op;
+
+		T t;
+
+		bool operator==(const compare&) const = default;
+
+		bool operator()(const T& u) const
+		{
+			return Op{}(u, t);
+		}
+	};
+	// Comparison whose threshold has type T.
+	template <class P, class T>
+	inline constexpr bool is_compare_of_v = false;
+	template <class Op, class T>
+	inline constexpr bool is_compare_of_v<compare<Op, T>, T> = true;
+
 	// Elements satisfying predicate.
+	// Comparisons with contiguous arithmetic data are vector compare and compress.
 	template <class P, input I, class T = typename I::value_type>
 	class filter {
-		P p;
-		I i;
+		FMS_NO_UNIQUE_ADDRESS P p;
+		cached_t<I> i;
 
 		void incr()
 		{
@@ -1204,15 +2583,15 @@ namespace fms::iterable {
 
 		filter(const filter& a)
 			: p(a.p), i(a.i)
+		{ }
+		filter(P&& _p, const I& _i)
+			: p(_p), i(_i)
 		{
-			incr();
-		}
-		filter(P&& p, const I& i)
-			: p(p), i(std::move(i))
-		{
-			incr();
+			if (i && !p(*i)) {
+				incr();
+			}
 		}
-		filter(filter&& a)
+		filter(filter&& a) noexcept(std::is_nothrow_copy_constructible_v<P> && std::is_nothrow_move_constructible_v<cached_t<I>>)
 			: p(a.p), i(std::move(a.i))
 		{ }
 		filter& operator=(const filter& a)
@@ -1263,13 +2642,56 @@ namespace fms::iterable {
 
 			return f;
 		}
+
+		// Pull blocks into s and compact survivors in place.
+		std::size_t next_batch(std::span<value_type> s)
+			requires batched<I, T>
+		{
+			std::size_t n = 0;
+
+			if constexpr (is_compare_of_v<P, T> && contiguous<cached_t<I>, T>) {
+				while (n < s.size()) {
+					auto r = s.size() - n;
+					auto a = i.next_span(r);
+					n += simd::compress(typename P::op{}, a.data(), a.size(), p.t, s.data() + n);
+					if (a.size() < r) {
+						break;
+					}
+				}
+			}
+			else {
+				if (n < s.size() && i) {
+					s[n++] = *i;
+					++i;
+				}
+				while (n < s.size()) {
+					auto r = s.size() - n;
+					auto m = i.next_batch(s.subspan(n, r));
+					auto k = n;
+					for (auto j = n; j < n + m; ++j) {
+						auto t = s[j];
+						s[k] = t;
+						k += p(t) ? 1 : 0;
+					}
+					n = k;
+					if (m < r) {
+						break;
+					}
+				}
+			}
+			while (i && !p(*i)) {
+				++i;
+			}
+
+			return n;
+		}
 	};
 
 	// Stop at first element satisfying predicate.
 	template <class P, input I, class T = typename I::value_type>
 	class until {
-		P p;
-		I i;
+		FMS_NO_UNIQUE_ADDRESS P p;
+		cached_t<I> i;
 	public:
 		using iterator_category = std::input_iterator_tag;
 		using value_type = T;
@@ -1284,7 +2706,7 @@ namespace fms::iterable {
 		until(const until& a)
 			: p(a.p), i(a.i)
 		{ }
-		until(until&& a)
+		until(until&& a) noexcept(std::is_nothrow_copy_constructible_v<P> && std::is_nothrow_move_constructible_v<cached_t<I>>)
 			: p(a.p), i(std::move(a.i))
 		{ }
 		until& operator=(const until& u)
@@ -1335,12 +2757,44 @@ namespace fms::iterable {
 
 			return u;
 		}
+
+		// Multi-pass sources read a block ahead on a copy and only the
+		// block containing the stopping element is traversed twice.
+		// Single-pass sources can not give back elements and computed sources
+		// must call their function once per element so are pulled one at a time.
+		std::size_t next_batch(std::span<value_type> s)
+			requires batched<I, T>
+		{
+			std::size_t n = 0;
+
+			if constexpr (multi_pass<I> && !is_computed_v<I>) {
+				auto j{ i };
+				auto m = j.next_batch(s);
+				while (n < m && !p(s[n])) {
+					++n;
+				}
+				if (n == m) {
+					i = j;
+				}
+				else {
+					i = drop(i, n);
+				}
+			}
+			else {
+				while (n < s.size() && i && !p(*i)) {
+					s[n++] = *i;
+					++i;
+				}
+			}
+
+			return n;
+		}
 	};
 
 	// Right fold: t, op(t, *i), op(op(t, *i), *++i), ...
 	template <class BinOp, input I, class T = typename I::value_type>
 	class fold {
-		BinOp op;
+		FMS_NO_UNIQUE_ADDRESS BinOp op;
 		I i;
 		T t;
 	public:
@@ -1357,6 +2811,10 @@ namespace fms::iterable {
 		fold(const fold& f)
 			: fold(f.op, f.i, f.t)
 		{ }
+		fold(fold&& f) noexcept(std::is_nothrow_copy_constructible_v<BinOp> && std::is_nothrow_move_constructible_v<I>
+			&& std::is_nothrow_move_constructible_v<T>)
+			: op(f.op), i(std::move(f.i)), t(std::move(f.t))
+		{ }
 		fold& operator=(const fold& f)
 		{
 			if (this != &f) {
@@ -1408,28 +2866,163 @@ namespace fms::iterable {
 			return f;
 		}
 	};
-	template <input I, class T = typename I::value_type>
-	inline auto sum(I i, T t = 0)
-	{
-		while (i) {
-			t += *i;
+
+	// Running reduction including the current element: *i, op(*i, *++i), ...
+	// or op(t, *i), op(op(t, *i), *++i), ... given t.
+	template <class BinOp, input I, class T = typename I::value_type>
+	class inclusive_scan {
+		FMS_NO_UNIQUE_ADDRESS BinOp op;
+		I i;
+		T t;
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using difference_type = typename I::difference_type;
+
+		inclusive_scan(const BinOp& op, const I& i)
+			: op(op), i(i), t(i ? T(*i) : T{})
+		{ }
+		inclusive_scan(const BinOp& op, const I& i, T t)
+			: op(op), i(i), t(i ? op(t, *i) : t)
+		{ }
+
+		bool operator==(const inclusive_scan& s) const
+		{
+			return i == s.i && t == s.t;
+		}
+
+		explicit operator bool() const
+		{
+			return i.operator bool();
+		}
+		value_type operator*() const noexcept
+		{
+			return t;
+		}
+		inclusive_scan& operator++()
+		{
+			if (i && ++i) {
+				t = op(t, *i);
+			}
+
+			return *this;
+		}
+		inclusive_scan operator++(int)
+		{
+			auto s{ *this };
+
+			operator++();
+
+			return s;
+		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return i.size();
+		}
+		std::size_t next_batch(std::span<value_type> s)
+			requires batched<I, T>
+		{
+			if (s.empty() || !i) {
+				return 0;
+			}
+
+			// current value then the scan of the next block
+			s[0] = t;
 			++i;
+			auto n = 1 + i.next_batch(s.subspan(1));
+			for (std::size_t k = 1; k < n; ++k) {
+				s[k] = op(s[k - 1], s[k]);
+			}
+			if (i) {
+				t = op(s[n - 1], *i);
+			}
+
+			return n;
+		}
+	};
+
+	// Running reduction excluding the current element: t, op(t, *i), ...
+	template <class BinOp, input I, class T = typename I::value_type>
+	inline auto exclusive_scan(const BinOp& op, const I& i, T t)
+	{
+		return fold(op, i, t);
+	}
+	template <class BinOp, input I>
+	inline auto scan(const BinOp& op, const I& i)
+	{
+		return inclusive_scan(op, i);
+	}
+	template <class BinOp, input I, class T>
+	inline auto scan(const BinOp& op, const I& i, T t)
+	{
+		return inclusive_scan(op, i, t);
+	}
+	// Floating point reductions use SIMD lanes in the summation mode S.
+	// Iterables without block pulls are buffered one element at a time.
+	template <simd::summation S = simd::summation::fast, simd::op O = simd::op::add, input I, class T>
+	inline T reduce_lanes(I& i, T t)
+	{
+		simd::accumulator<T, S, O> a(t);
+
+		if constexpr (contiguous<I>) {
+			for (;;) {
+				auto s = i.next_span(std::size_t(1) << 20);
+				a.add(s.data(), s.size());
+				if (s.size() < (std::size_t(1) << 20)) {
+					break;
+				}
+			}
+		}
+		else {
+			for_each_batch(i, [&a](auto s) { a.add(s.data(), s.size()); });
 		}
 
-		return t;
+		return a.value();
 	}
-	template <class E, input I, class T = typename I::value_type>
-	inline auto sum(I i, T t = 0, E e = std::execution::seq)
+
+	template <simd::summation S = simd::summation::fast, input I, class T = typename I::value_type>
+	inline auto sum(I i, T t = 0)
 	{
-		return std::reduce(e, begin(i), end(i), t);
+		if constexpr (std::is_floating_point_v<T> && std::same_as<T, typename I::value_type>) {
+			t = reduce_lanes<S>(i, t);
+		}
+		else if constexpr (batched<I>) {
+			for_each_batch(i, [&t](auto s) {
+				for (const auto& x : s) {
+					t += x;
+				}
+			});
+		}
+		else {
+			while (i) {
+				t += *i;
+				++i;
+			}
+		}
+
+		return t;
 	}
 
 	template <input I, class T = typename I::value_type>
 	inline auto prod(I i, T t = 1)
 	{
-		while (i) {
-			t *= *i;
-			++i;
+		if constexpr (std::is_floating_point_v<T> && std::same_as<T, typename I::value_type>) {
+			t = reduce_lanes<simd::summation::fast, simd::op::mul>(i, t);
+		}
+		else if constexpr (batched<I>) {
+			for_each_batch(i, [&t](auto s) {
+				for (const auto& x : s) {
+					t *= x;
+				}
+			});
+		}
+		else {
+			while (i) {
+				t *= *i;
+				++i;
+			}
 		}
 
 		return t;
@@ -1440,8 +3033,8 @@ namespace fms::iterable {
 	template <input I, class T = typename I::value_type, class D = std::minus<T>, 
 		typename U = std::invoke_result_t<D, T, T>>
 	class delta {
-		D d;
-		I i;
+		FMS_NO_UNIQUE_ADDRESS D d;
+		cached_t<I> i;
 		T t, _t;
 		void init()
 		{
@@ -1469,6 +3062,10 @@ namespace fms::iterable {
 		delta(const delta& _d)
 			: d(_d.d), i(_d.i), t(_d.t), _t(_d._t)
 		{ }
+		delta(delta&& _d) noexcept(std::is_nothrow_copy_constructible_v<D> && std::is_nothrow_move_constructible_v<cached_t<I>>
+			&& std::is_nothrow_move_constructible_v<T>)
+			: d(_d.d), i(std::move(_d.i)), t(std::move(_d.t)), _t(std::move(_d._t))
+		{ }
 		delta& operator=(const delta& _d)
 		{
 			if (this != &_d) {
@@ -1479,6 +3076,16 @@ namespace fms::iterable {
 
 			return *this;
 		}
+		delta& operator=(delta&& _d)
+		{
+			if (this != &_d) {
+				i = std::move(_d.i);
+				t = std::move(_d.t);
+				_t = std::move(_d._t);
+			}
+
+			return *this;
+		}
 		~delta()
 		{ }
 
@@ -1514,6 +3121,9 @@ namespace fms::iterable {
 		}
 	};
 
+	template <class I, class T, class D, class U>
+	inline constexpr bool is_computed_v<delta<I, T, D, U>> = true;
+
 	// uptick + downtick = delta
 	template <input I, class T = typename I::value_type>
 	inline auto uptick(I i)
@@ -1533,7 +3143,7 @@ namespace fms::iterable {
 	public:
 		using iterator_category = std::input_iterator_tag;
 		using value_type = std::pair<typename I::value_type, typename J::value_type>;
-		using difference_type = std::common_type<typename I::difference_type, typename J::difference_type>;
+		using difference_type = std::common_type_t<typename I::difference_type, typename J::difference_type>;
 
 		pair(I i, J j)
 			: i(i), j(j)
@@ -1562,6 +3172,25 @@ namespace fms::iterable {
 
 			return p;
 		}
+
+		pair& operator+=(difference_type n)
+			requires advanceable<I> && advanceable<J>
+		{
+			i += static_cast<typename I::difference_type>(n);
+			j += static_cast<typename J::difference_type>(n);
+
+			return *this;
+		}
+		value_type operator[](difference_type n) const
+			requires random_access<I> && random_access<J>
+		{
+			return { i[static_cast<typename I::difference_type>(n)], j[static_cast<typename J::difference_type>(n)] };
+		}
+		difference_type distance(const pair& p) const
+			requires distanced<I>
+		{
+			return i.distance(p.i);
+		}
 	};
 
 } // namespace fms::iterable
@@ -1573,6 +3202,7 @@ namespace fms::iterable {
     X(/, std::divides<T>{})     \
     X(%, std::modulus<T>{})
 
+// constant op constant is a constant.
 #define FMS_ITERABLE_OPERATOR_FUNCTION(OP, OP_)              \
     template <fms::iterable::input I,                        \
         fms::iterable::input J,                              \
@@ -1580,15 +3210,42 @@ namespace fms::iterable {
             typename J::value_type>>                         \
     inline auto operator OP(const I& i, const J& j)          \
     {                                                        \
-        return fms::iterable::binop(OP_, i, j);              \
-    }    
+        if constexpr (fms::iterable::is_constant_v<I>        \
+            && fms::iterable::is_constant_v<J>) {            \
+            return fms::iterable::constant<T>(OP_(*i, *j));  \
+        }                                                    \
+        else {                                               \
+            return fms::iterable::binop(OP_, i, j);          \
+        }                                                    \
+    }                                                        \
+    template <fms::iterable::input I, class U,               \
+        class T = std::common_type_t<typename I::value_type, \
+            U>>                                              \
+        requires (std::is_arithmetic_v<U>)                   \
+    inline auto operator OP(const I& i, const U& u)          \
+    {                                                        \
+        return i OP fms::iterable::constant<T>(u);           \
+    }                                                        \
+    template <fms::iterable::input I, class U,               \
+        class T = std::common_type_t<typename I::value_type, \
+            U>>                                              \
+        requires (std::is_arithmetic_v<U>)                   \
+    inline auto operator OP(const U& u, const I& i)          \
+    {                                                        \
+        return fms::iterable::constant<T>(u) OP i;           \
+    }
 FMS_ITERABLE_OPERATOR(FMS_ITERABLE_OPERATOR_FUNCTION)
 #undef FMS_ITERABLE_OPERATOR_FUNCTION
 
 template<fms::iterable::input I, class T = typename I::value_type>
 inline auto operator-(const I& i)
 {
-	return fms::iterable::constant(T(-1)) * i;
+	if constexpr (fms::iterable::is_constant_v<I>) {
+		return fms::iterable::constant<T>(-*i);
+	}
+	else {
+		return fms::iterable::apply(std::negate<T>{}, i);
+	}
 }
 
 template <fms::iterable::input I, fms::iterable::input J>
@@ -1616,23 +3273,27 @@ inline auto operator==(const I& i, T t) { return fms::iterable::filter([t](T u)
 I::value_type> inline auto operator!=(const I& i, T t) { return
 fms::iterable::filter([t](T u) { return u != t; }, i); }
 */
-template<fms::iterable::input I, class T = typename I::value_type>
+template<fms::iterable::input I, class T, class V = std::common_type_t<typename I::value_type, T>>
+	requires std::is_arithmetic_v<T>
 inline auto operator<(const I& i, T t)
 {
-	return fms::iterable::filter([t](T u) { return u < t; }, i);
+	return fms::iterable::filter(fms::iterable::compare<std::less<V>, V>{ static_cast<V>(t) }, i);
 }
-template<fms::iterable::input I, class T = typename I::value_type>
+template<fms::iterable::input I, class T, class V = std::common_type_t<typename I::value_type, T>>
+	requires std::is_arithmetic_v<T>
 inline auto operator<=(const I& i, T t)
 {
-	return fms::iterable::filter([t](T u) { return u <= t; }, i);
+	return fms::iterable::filter(fms::iterable::compare<std::less_equal<V>, V>{ static_cast<V>(t) }, i);
 }
-template<fms::iterable::input I, class T = typename I::value_type>
+template<fms::iterable::input I, class T, class V = std::common_type_t<typename I::value_type, T>>
+	requires std::is_arithmetic_v<T>
 inline auto operator>(const I& i, T t)
 {
-	return fms::iterable::filter([t](T u) { return u > t; }, i);
+	return fms::iterable::filter(fms::iterable::compare<std::greater<V>, V>{ static_cast<V>(t) }, i);
 }
-template<fms::iterable::input I, class T = typename I::value_type>
+template<fms::iterable::input I, class T, class V = std::common_type_t<typename I::value_type, T>>
+	requires std::is_arithmetic_v<T>
 inline auto operator>=(const I& i, T t)
 {
-	return fms::iterable::filter([t](T u) { return u >= t; }, i);
+	return fms::iterable::filter(fms::iterable::compare<std::greater_equal<V>, V>{ static_cast<V>(t) }, i);
 }
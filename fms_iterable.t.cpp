@@ -1,14 +1,50 @@
 // fms_iterable.t.cpp - test fms::iterable
 #include "fms_time.h"
 #include "fms_iterable.h"
+#include "fms_iterable_any.h"
+#include "fms_iterable_channel.h"
+#include "fms_iterable_generator.h"
+#include "fms_iterable_join.h"
+#include "fms_iterable_mmap.h"
+#include "fms_iterable_parallel.h"
+#include "fms_iterable_parse.h"
+#include "fms_iterable_prefetch.h"
+#include "fms_iterable_recurrence.h"
+#include "fms_iterable_rolling.h"
 #include <cassert>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 // #include "fms_time.h"
 // #include "tmx_math_limits.h"
 
 using namespace fms::iterable;
 
+// Count allocations made by this thread.
+thread_local std::size_t allocations = 0;
+void* operator new(std::size_t n)
+{
+	++allocations;
+	if (void* p = std::malloc(n ? n : 1)) {
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
 int test_interval() {
 	{
 		std::vector v{ 1, 2, 3 };
@@ -141,6 +177,15 @@ int test_skip() {
 		assert(*i == 0);
 		assert(*j == 2);
 	}
+	{
+		// n past the maximum difference_type does not go backward
+		std::vector<int> v{ 1, 2, 3 };
+		auto n = std::numeric_limits<std::size_t>::max();
+		static_assert(advanceable<decltype(make_interval(v))>);
+		assert(!drop(make_interval(v), n));
+		assert(!drop(make_interval(v), n - 1));
+		assert(!drop(pointer(v.data(), 3), n));
+	}
 
 	return 0;
 }
@@ -496,15 +541,39 @@ int test_concatenate() {
 		assert(equal(v, _v));
 	}
 	{
-		/*
-		vector v1({ 1,2 }), v2({ 3, 4, 5 }), v3({ 6, 7, 8, 9 });
-		const auto v = concatenate(v1, v2, v3);
-		assert(equal(v, list({ 1, 2, 3, 4, 5, 6, 7, 8, 9 })));
+		vector<int> v1({ 1,2 }), v2({ 3, 4, 5 }), v3({ 6, 7, 8, 9 });
+		const auto v = concatenate(v1, empty<int>{}, v2, v3);
+		static_assert(std::same_as<decltype(v), const concatenate_tuple<vector<int>, empty<int>, vector<int>, vector<int>>>);
+		assert(v.size() == 9);
+		assert(equal(v, take(iota(1), 9)));
 
-		const auto v_ = v;
+		auto v_ = v;
 		assert(equal(v, v_));
-		assert(equal(v, take(iota(1), 9)));
-		*/
+		int b[5];
+		assert(5 == v_.next_batch(std::span(b)));
+		assert(b[4] == 5);
+		assert(v_.size() == 4);
+		assert(*v_ == 6);
+		assert(4 == v_.next_batch(std::span(b)));
+		assert(!v_);
+	}
+	{
+		std::vector<vector<int>> vs;
+		for (int n = 0; n < 100; ++n) {
+			vs.push_back(make_vector(take(iota(n * (n - 1) / 2), std::size_t(n))));
+		}
+		auto c = concatenate(vs);
+		assert(c.size() == 99 * 100 / 2);
+		assert(equal(c, take(iota(0), 99 * 100 / 2)));
+		assert(equal(make_vector(c), take(iota(0), 99 * 100 / 2))); // batched
+		assert(!concatenate(std::vector<iota<int>>{}));
+		// size is kept through increments and batches
+		++c;
+		assert(c.size() == 99 * 100 / 2 - 1);
+		int b[100];
+		assert(100 == c.next_batch(std::span(b)));
+		assert(c.size() == 99 * 100 / 2 - 101 && *c == 101);
+		assert(length(c) == c.size());
 	}
 
 	return 0;
@@ -574,6 +643,30 @@ int test_merge() {
 		auto l = merge(j, k);
 		//assert(equal(take(l, 6), list({ 2, 3, 4, 6, 6, 8 })));
 	}
+	{
+		int i[] = { 1, 4, 7 };
+		int j[] = { 2, 4, 8 };
+		auto c = merge(array(i), array(j), iota(3), empty<int>{});
+		assert(equal(take(c, 10), vector<int>({ 1, 2, 3, 4, 4, 4, 5, 6, 7, 7 })));
+		auto d = merge(empty<int>{}, empty<int>{}, empty<int>{});
+		assert(!d);
+	}
+	{
+		// k sorted streams of multiples of k - j
+		constexpr int k = 300;
+		std::vector<take<iota<int>>> is;
+		std::vector<int> all;
+		for (int j = 0; j < k; ++j) {
+			is.push_back(take(iota(j), std::size_t(j % 7)));
+			for (int n = 0; n < j % 7; ++n) {
+				all.push_back(j + n);
+			}
+		}
+		std::sort(all.begin(), all.end());
+		auto m = merge(is);
+		assert(equal(m, make_interval(all)));
+		assert(!merge(std::vector<iota<int>>{}));
+	}
 	{
 		/*
 		vector v({ 1,2,3 });
@@ -627,6 +720,15 @@ int test_call() {
 
 		//assert(equal(take(c, 3), list({ 0, 1, 2 })));
 	}
+	{
+		// difference_type is void
+		int k = 0;
+		auto t = take(call([&k]() { return k++; }), 3);
+		assert(sum(t) == 0 + 1 + 2);
+		auto a = take(apply([](int x) { return 2 * x; }, call([&k]() { return k++; })), 2);
+		assert(sum(a) == 2 * 3 + 2 * 4);
+		static_assert(!advanceable<decltype(t)> && !advanceable<decltype(a)>);
+	}
 
 	return 0;
 }
@@ -667,6 +769,1535 @@ int test_pair()
 	return 0;
 }
 
+int test_batch()
+{
+	{
+		int i[] = { 1, 2, 3, 4, 5 };
+		pointer p(i, 5);
+		int b[3];
+		assert(3 == p.next_batch(std::span(b)));
+		assert(b[0] == 1 && b[2] == 3);
+		assert(*p == 4);
+		assert(2 == p.next_batch(std::span(b)));
+		assert(b[1] == 5);
+		assert(!p);
+	}
+	{
+		iota<int> i(1);
+		int b[3];
+		assert(3 == i.next_batch(std::span(b)));
+		assert(b[0] == 1 && b[2] == 3);
+		assert(*i == 4);
+	}
+	{
+		power<int> p(2);
+		int b[4];
+		assert(4 == p.next_batch(std::span(b)));
+		assert(b[0] == 1 && b[3] == 8);
+		assert(*p == 16);
+	}
+	{
+		static_assert(batched<pointer<int>>);
+		static_assert(batched<take<iota<int>>>);
+		static_assert(!batched<choose<>>);
+		choose<std::size_t> c(3);
+		std::size_t b[5];
+		assert(4 == next_batch(c, std::span(b))); // fallback
+		assert(b[0] == 1 && b[1] == 3 && b[2] == 3 && b[3] == 1);
+		assert(!c);
+	}
+	{
+		auto t = take(apply([](int x) { return 2 * x; }, iota<int>(0)), 1000);
+		assert(sum(t) == 999 * 1000);
+		assert(equal(t, take(constant(2) * iota<int>(0), 1000)));
+		auto v = make_vector(t);
+		assert(length(v) == 1000);
+		assert(equal(v, t));
+	}
+	{
+		auto f = take(filter([](int x) { return x % 3 == 0; }, iota<int>(1)), 600);
+		auto f2(f);
+		assert(*f2 == 3);
+		int s = 0;
+		for (int x = 3; x <= 1800; x += 3) {
+			s += x;
+		}
+		assert(sum(f) == s);
+		assert(equal(make_vector(f), f2));
+	}
+	{
+		auto u = until([](int x) { return x > 1000; }, iota<int>(0));
+		assert(sum(u) == 1000 * 1001 / 2);
+		int b[1100];
+		assert(1001 == u.next_batch(std::span(b)));
+		assert(!u);
+		assert(*u == 1001);
+	}
+	{
+		const auto eps = [](double x) { return x + 1 == 1; };
+		auto e = until(eps, power(1.) / factorial());
+		assert(std::fabs(sum(e) - std::exp(1.)) <= 5e-16);
+		assert(length(make_vector(e)) == length(e));
+	}
+
+	return 0;
+}
+
+int test_simd()
+{
+	const auto detected = fms::simd::detect();
+	for (auto l : { fms::simd::isa::scalar, fms::simd::isa::sse2, fms::simd::isa::avx2, fms::simd::isa::avx512 }) {
+		if (l > detected) {
+			break;
+		}
+		fms::simd::level() = l;
+
+		constexpr std::size_t n = 1003;
+		std::vector<double> a(n), b(n);
+		for (std::size_t k = 0; k < n; ++k) {
+			a[k] = 1 + k;
+			b[k] = 0.5 * k - 7;
+		}
+		static_assert(contiguous<pointer<double>>);
+		{
+			auto v = make_vector(pointer(a.data(), n) + pointer(b.data(), n));
+			assert(length(v) == n);
+			for (std::size_t k = 0; k < n; ++k, ++v) {
+				assert(*v == a[k] + b[k]);
+			}
+		}
+		{
+			auto v = make_vector(make_interval(a) / make_interval(b));
+			for (std::size_t k = 0; k < n; ++k, ++v) {
+				assert(*v == a[k] / b[k]);
+			}
+		}
+		{
+			auto v = make_vector(pointer(a.data(), n) - pointer(b.data(), n - 2));
+			assert(length(v) == n - 2);
+			assert(*drop(v, n - 3) == a[n - 3] - b[n - 3]);
+		}
+		{
+			double s = 0;
+			for (std::size_t k = 0; k < n; ++k) {
+				s += a[k] * b[k];
+			}
+			assert(sum(pointer(a.data(), n) * pointer(b.data(), n)) == s);
+		}
+		{
+			// no vector kernel for bool
+			static_assert(!fms::simd::elementwise<std::plus<bool>, bool>);
+			bool c[] = { true, false, true };
+			assert(length(pointer(c, 3) + pointer(c, 3)) == 3);
+			assert(sum(pointer(c, 3) + pointer(c, 3)));
+		}
+	}
+	fms::simd::level() = detected;
+
+	return 0;
+}
+
+int test_accumulator()
+{
+	using fms::simd::accumulator;
+	using fms::simd::summation;
+
+	constexpr std::size_t n = 100'003;
+	std::vector<double> x(n);
+	long double exact = 0;
+	for (std::size_t k = 0; k < n; ++k) {
+		x[k] = 1 + 1e3 * std::sin(double(k));
+		exact += x[k];
+	}
+	const auto ulps = [exact](double s) { return std::fabs(s - double(exact)) / std::fabs(std::nextafter(double(exact), 0.) - double(exact)); };
+
+	const auto detected = fms::simd::detect();
+	for (auto l : { fms::simd::isa::scalar, fms::simd::isa::sse2, fms::simd::isa::avx2, fms::simd::isa::avx512 }) {
+		if (l > detected) {
+			break;
+		}
+		fms::simd::level() = l;
+
+		auto p = pointer(x.data(), n);
+		assert(ulps(sum(p)) < 1e3);
+		assert(ulps(sum<summation::pairwise>(p)) < 1e3);
+		assert(ulps(sum<summation::compensated>(p)) <= 1);
+		assert(ulps(sum<summation::reproducible>(p)) < 1e3);
+
+		// independent of block size
+		const double r = sum<summation::reproducible>(p);
+		for (std::size_t b : { 1, 7, 256, 5000 }) {
+			accumulator<double, summation::reproducible> a;
+			for (std::size_t k = 0; k < n; k += b) {
+				a.add(x.data() + k, std::min(b, n - k));
+			}
+			assert(a.value() == r);
+		}
+		assert(sum<summation::reproducible>(make_interval(x)) == r);
+		assert(sum<summation::reproducible>(apply([](double t) { return t; }, p)) == r);
+		assert(sum(take(p, 10)) == sum(take(p, 10), 0., std::execution::seq));
+	}
+	{
+		// the summation mode does not depend on block pulls
+		double y[] = { 1e16, 1, -1e16 };
+		auto q = pointer(y, 3);
+		static_assert(!batched<decltype(merge2(q, empty<double>()))>);
+		assert(sum<summation::compensated>(q) == 1);
+		assert(sum<summation::compensated>(generate(q)) == 1);
+		assert(sum<summation::compensated>(merge2(empty<double>(), q)) == 1);
+		auto p = pointer(x.data(), n);
+		const double r = sum<summation::reproducible>(p);
+		assert(sum<summation::reproducible>(generate(p)) == r);
+		assert(parallel::sum<summation::reproducible>(generate(p)) == r);
+	}
+	fms::simd::level() = detected;
+	{
+		double y[] = { 1, 2, 3, 4, 5 };
+		assert(prod(pointer(y, 5)) == 120);
+		assert(prod(take(power(2.), 10)) == std::pow(2., 45));
+		assert(prod(take(iota(1), 5)) == 120);
+	}
+
+	return 0;
+}
+
+int test_parallel()
+{
+	using fms::simd::summation;
+
+	fms::thread_pool pool(3);
+	{
+		std::atomic<int> n = 0;
+		pool.run(100, [&n](std::size_t k) { n += int(k); });
+		assert(n == 99 * 100 / 2);
+	}
+	{
+		bool thrown = false;
+		try {
+			pool.run(10, [](std::size_t k) { if (k == 7) throw k; });
+		}
+		catch (std::size_t k) {
+			thrown = k == 7;
+		}
+		assert(thrown);
+	}
+
+	static_assert(parallel::partitionable<pointer<double>>);
+	static_assert(parallel::partitionable<take<iota<int>>>);
+	static_assert(parallel::partitionable<apply<std::negate<double>, pointer<double>>>);
+	static_assert(!parallel::partitionable<iota<int>>);
+	static_assert(!parallel::partitionable<filter<bool(*)(int), pointer<int>>>);
+
+	constexpr std::size_t n = 1'000'003;
+	std::vector<double> x(n);
+	for (std::size_t k = 0; k < n; ++k) {
+		x[k] = 1 + 1e3 * std::sin(double(k));
+	}
+	auto p = pointer(x.data(), n);
+	{
+		auto s = sum(p);
+		assert(std::fabs(parallel::sum(p, 0., pool) - s) <= 1e-9 * std::fabs(s));
+		assert(std::fabs(sum(p, 0., std::execution::par) - s) <= 1e-9 * std::fabs(s));
+		assert(sum(p, 0., std::execution::seq) == s);
+	}
+	{
+		auto r = sum<summation::reproducible>(p);
+		for (std::size_t threads : { 0, 1, 2, 5 }) {
+			fms::thread_pool pool_(threads);
+			assert(parallel::sum<summation::reproducible>(p, 0., pool_) == r);
+		}
+		assert(parallel::sum<summation::reproducible>(make_interval(x), 0., pool) == r);
+	}
+	{
+		auto i = take(iota<long long>(1), n);
+		assert(parallel::sum(i, 0LL, pool) == (long long)n * (n + 1) / 2);
+		assert(parallel::reduce(i, 0LL, std::plus<long long>{}, pool) == (long long)n * (n + 1) / 2);
+		auto sq = apply([](long long k) { return k * k % 7; }, i);
+		assert(parallel::sum(sq, 0LL, pool) == sum(sq));
+		auto b = i * i - i;
+		assert(parallel::sum(b, 0LL, pool) == sum(b));
+	}
+	{
+		auto f = filter([](int k) { return k % 2 == 0; }, take(iota<int>(0), 1000)); // not partitionable
+		assert(parallel::sum(f, 0, pool) == sum(f));
+	}
+
+	return 0;
+}
+
+int test_random_access()
+{
+	static_assert(random_access<iota<int>>);
+	static_assert(random_access<power<double>>);
+	static_assert(random_access<constant<int>>);
+	static_assert(random_access<pointer<int>>);
+	static_assert(random_access<vector<int>>);
+	static_assert(random_access<choose<int>>);
+	static_assert(random_access<take<iota<int>>>);
+	static_assert(random_access<apply<std::negate<int>, iota<int>>>);
+	static_assert(random_access<binop<std::plus<int>, iota<int>, pointer<int>>>);
+	static_assert(random_access<pair<iota<int>, power<int>>>);
+	static_assert(!random_access<filter<bool(*)(int), iota<int>>>);
+	static_assert(!random_access<binop<std::plus<int>, iota<int>, filter<bool(*)(int), iota<int>>>>);
+	static_assert(distanced<pointer<int>>);
+	static_assert(!distanced<power<int>>);
+	{
+		auto i = iota(1);
+		assert(i[3] == 4);
+		auto j = drop(i, 1'000'000);
+		assert(*j == 1'000'001);
+		assert(i.distance(j) == 1'000'000);
+	}
+	{
+		auto p = power(3);
+		assert(p[4] == 81);
+		p += 2;
+		assert(*p == 9);
+		assert(p[1] == 27);
+		assert(*drop(power(0.5), 10) == std::pow(0.5, 10));
+	}
+	{
+		auto c = choose<std::size_t>(5);
+		assert(c[2] == 10);
+		assert(c[6] == 0);
+		c += 3;
+		assert(*c == 10);
+		assert(*++c == 5);
+		assert(length(drop(c, 10)) == 0);
+	}
+	{
+		int a[] = { 1, 2, 3, 4 };
+		auto p = pointer(a, 4);
+		assert(p[2] == 3);
+		auto q = drop(p, 3);
+		assert(*q == 4);
+		assert(p.distance(q) == 3);
+		assert(!drop(p, 5));
+		auto v = make_vector(p);
+		assert(v[3] == 4);
+		assert(*drop(v, 2) == 3);
+		assert(!drop(v, 4));
+		assert(v.distance(drop(v, 2)) == 2);
+		auto t = take(iota(0), 10);
+		assert(t.distance(drop(t, 4)) == 4);
+		assert(t.distance(drop(t, 40)) == 10);
+	}
+	{
+		auto b = iota(0) * power(2);
+		assert(b[10] == 10 * 1024);
+		assert(*drop(b, 3) == 24);
+		auto a = apply([](int k) { return k * k; }, iota(0));
+		assert(a[7] == 49);
+		auto p = pair(iota(0), constant('a'));
+		assert(p[5] == std::pair(5, 'a'));
+	}
+
+	return 0;
+}
+
+int test_sized()
+{
+	static_assert(sized<pointer<int>>);
+	static_assert(sized<vector<int>>);
+	static_assert(sized<once<int>>);
+	static_assert(sized<empty<int>>);
+	static_assert(sized<choose<int>>);
+	static_assert(sized<take<iota<int>>>);
+	static_assert(sized<concatenate2<once<int>, take<iota<int>>>>);
+	static_assert(!sized<concatenate2<once<int>, iota<int>>>);
+	static_assert(!sized<iota<int>>);
+	static_assert(!sized<filter<bool(*)(int), pointer<int>>>);
+	{
+		int a[] = { 1, 2, 3, 4 };
+		auto p = pointer(a, 4);
+		assert(length(p) == 4);
+		assert(*back(p) == 4);
+		assert(!end(p));
+		assert(length(back(p)) == 1);
+		assert(length(empty<int>{}) == 0);
+		assert(length(choose(4)) == 5);
+		assert(length(drop(choose(4), 2)) == 3);
+	}
+	{
+		auto c = concatenate(once(1), take(iota(2), 3), vector<int>({ 5, 6 }));
+		assert(c.size() == 6);
+		assert(length(c) == 6);
+		assert(*back(c) == 6);
+		assert(length(drop(c, 2)) == 4);
+		assert(*drop(c, 4) == 5);
+		assert(!drop(c, 10));
+		assert(!equal(c, take(iota(1), 5)));
+		assert(equal(c, take(iota(1), 6)));
+	}
+	{
+		auto v = make_vector(take(iota(0), 1000));
+		assert(v.size() == 1000);
+		assert(*back(v) == 999);
+		assert(length(++v) == 999);
+	}
+
+	return 0;
+}
+
+int test_simplify()
+{
+	{
+		auto c = constant(2) * constant(3) + constant(1);
+		static_assert(std::same_as<decltype(c), constant<int>>);
+		assert(*c == 7);
+		auto d = -constant(2.);
+		static_assert(std::same_as<decltype(d), constant<double>>);
+		assert(*d == -2);
+	}
+	{
+		auto f = [](int k) { return k + 1; };
+		auto g = [](int k) { return 2 * k; };
+		auto a = apply(f, apply(g, iota(0)));
+		static_assert(std::same_as<decltype(a), apply<compose<decltype(f), decltype(g)>, iota<int>>>);
+		assert(equal(take(a, 3), vector<int>({ 1, 3, 5 })));
+		auto n = -a;
+		static_assert(std::same_as<decltype(n), apply<compose<std::negate<int>, compose<decltype(f), decltype(g)>>, iota<int>>>);
+		assert(*++n == -3);
+	}
+	{
+		auto i = 1 + 2 * iota(0);
+		assert(equal(take(i, 4), vector<int>({ 1, 3, 5, 7 })));
+		assert(equal(take(10 - iota(0), 3), vector<int>({ 10, 9, 8 })));
+		assert(equal(take(iota(0) / 2, 4), vector<int>({ 0, 0, 1, 1 })));
+	}
+	{
+		// scalars are not truncated to the element type
+		std::vector<int> x{ 1, 2, 3 };
+		auto y = pointer(x.data(), x.size()) * 2.5;
+		static_assert(std::same_as<decltype(y)::value_type, double>);
+		assert(sum(y) == 15);
+		assert(sum(0.5 + take(iota(1), 3)) == 7.5);
+		assert(sum(pointer(x.data(), x.size()) / 2.) == 3);
+	}
+	{
+		std::vector<double> x(1000);
+		for (std::size_t k = 0; k < x.size(); ++k) {
+			x[k] = 0.5 * double(k);
+		}
+		auto p = pointer(x.data(), x.size());
+		std::vector<double> y(x.size());
+		for (double c : { 0., 1., 3. }) {
+			for (auto v : { make_vector(p + c), make_vector(c + p), make_vector(p - c),
+				make_vector(c - p), make_vector(p * c), make_vector(c * p), make_vector(p / (c + 1)) }) {
+				assert(v.size() == x.size());
+			}
+			auto v = make_vector(c - p * c);
+			for (std::size_t k = 0; k < x.size(); ++k) {
+				assert(v[k] == c - x[k] * c);
+			}
+			// non-contiguous side
+			auto w = make_vector(take(iota(0.), 1000) * c);
+			for (std::size_t k = 0; k < 1000; ++k) {
+				assert(w[k] == k * c);
+			}
+		}
+		// infinity * 0 is not 0
+		x[3] = std::numeric_limits<double>::infinity();
+		auto v = make_vector(p * 0.);
+		assert(std::isnan(v[3]));
+		assert(v[2] == 0);
+		// signed zeros match the scalar operation
+		x[4] = -0.;
+		for (double c : { 0., -0. }) {
+			for (auto w : { make_vector(p + c), make_vector(p - c), make_vector(p * c), make_vector(c * p) }) {
+				assert(w[4] == 0);
+			}
+			assert(std::signbit(make_vector(p + c)[4]) == std::signbit(-0. + c));
+			assert(std::signbit(make_vector(p - c)[4]) == std::signbit(-0. - c));
+			assert(std::signbit(make_vector(p * c)[4]) == std::signbit(-0. * c));
+			assert(std::signbit(make_vector(c * p)[2]) == std::signbit(c * 1.));
+		}
+		// zero multiplier still has the length of i
+		auto z = make_vector(take(iota(1), 5) * 0);
+		assert(z.size() == 5);
+		assert(sum(z) == 0);
+	}
+
+	return 0;
+}
+
+template <class T>
+void test_compress(std::size_t n)
+{
+	std::vector<T> a(n), b(n), c(n);
+	for (std::size_t k = 0; k < n; ++k) {
+		a[k] = static_cast<T>((k * 37) % 101);
+	}
+	T t = 50;
+	const auto check = [&](auto f) {
+		auto e = std::copy_if(a.begin(), a.end(), b.begin(), [&](T x) { return f(x, t); }) - b.begin();
+		auto m = fms::simd::compress(f, a.data(), n, t, c.data());
+		assert(m == std::size_t(e));
+		assert(std::equal(b.begin(), b.begin() + e, c.begin()));
+		// in place
+		c = a;
+		m = fms::simd::compress(f, c.data(), n, t, c.data());
+		assert(std::equal(b.begin(), b.begin() + e, c.begin()));
+	};
+	check(std::less<T>{});
+	check(std::less_equal<T>{});
+	check(std::greater<T>{});
+	check(std::greater_equal<T>{});
+
+	auto p = pointer(a.data(), n);
+	auto v = make_vector(p > t);
+	assert(equal(v, filter([t](T x) { return x > t; }, p)));
+	assert(sum(p <= t) == sum(filter([t](T x) { return x <= t; }, p)));
+	assert(equal(make_interval(a) < t, filter([t](T x) { return x < t; }, p)));
+}
+
+int test_filter_simd()
+{
+	const auto detected = fms::simd::detect();
+	for (auto l : { fms::simd::isa::scalar, fms::simd::isa::sse2, fms::simd::isa::avx2, fms::simd::isa::avx512 }) {
+		if (l > detected) {
+			break;
+		}
+		fms::simd::level() = l;
+
+		for (std::size_t n : { 0, 1, 7, 33, 1000, 1003 }) {
+			test_compress<double>(n);
+			test_compress<float>(n);
+			test_compress<int>(n);
+			test_compress<unsigned>(n);
+			test_compress<long long>(n);
+			test_compress<unsigned long long>(n);
+			test_compress<short>(n);
+			test_compress<long double>(n);
+		}
+		{
+			// first element fails, batches end between matches
+			std::vector<double> x{ 3, 1, 4, 1, 5, 9, 2, 6 };
+			auto f = pointer(x.data(), x.size()) >= 4.;
+			assert(*f == 4);
+			double b[2];
+			assert(2 == f.next_batch(std::span(b)));
+			assert(b[0] == 4 && b[1] == 5);
+			assert(*f == 9);
+			assert(2 == f.next_batch(std::span(b)));
+			assert(!f);
+		}
+		{
+			// threshold type differs from the data
+			std::vector<double> x{ 1.5, 2, 2.5, 3, 0.5 };
+			assert(sum(pointer(x.data(), x.size()) > 2) == 5.5);
+			assert(make_vector(pointer(x.data(), x.size()) <= 2).size() == 3);
+			std::vector<int> y{ 1, 2, 3 };
+			assert(sum(pointer(y.data(), y.size()) < 2.5) == 3);
+		}
+	}
+	fms::simd::level() = detected;
+
+	return 0;
+}
+
+int test_scan()
+{
+	{
+		auto s = scan(std::plus<int>{}, take(iota(1), 5));
+		assert(equal(s, vector<int>({ 1, 3, 6, 10, 15 })));
+		assert(s.size() == 5);
+		assert(equal(scan(std::plus<int>{}, take(iota(1), 3), 10), vector<int>({ 11, 13, 16 })));
+		assert(equal(exclusive_scan(std::plus<int>{}, take(iota(1), 3), 10), vector<int>({ 10, 11, 13 })));
+		assert(!scan(std::plus<int>{}, empty<int>{}));
+		// batches
+		auto v = make_vector(inclusive_scan(std::multiplies<long long>{}, take(iota<long long>(1), 20)));
+		assert(v.size() == 20);
+		assert(v[19] == 2432902008176640000LL); // 20!
+		auto w = inclusive_scan(std::plus<int>{}, take(iota(0), 1000));
+		int b[300];
+		assert(300 == w.next_batch(std::span(b)));
+		assert(b[299] == 299 * 300 / 2);
+		assert(*w == 300 * 301 / 2);
+		++w;
+		assert(*w == 301 * 302 / 2);
+	}
+
+	fms::thread_pool pool(3);
+	constexpr std::size_t n = 1'000'003;
+	{
+		auto i = take(iota<long long>(1), n);
+		std::vector<long long> out(n);
+		auto o = parallel::inclusive_scan(i, pointer(out.data(), n), std::plus<long long>{}, pool);
+		assert(o.size() == n);
+		for (std::size_t k = 0; k < n; k += 997) {
+			auto k_ = static_cast<long long>(k);
+			assert(out[k] == (k_ + 1) * (k_ + 2) / 2);
+		}
+		assert(out[n - 1] == (long long)n * (n + 1) / 2);
+
+		auto e = parallel::exclusive_scan(i, 5LL, std::plus<long long>{}, pool);
+		assert(e.size() == n);
+		assert(e[0] == 5);
+		assert(e[n - 1] == 5 + (long long)(n - 1) * n / 2);
+
+		// short output buffer
+		o = parallel::inclusive_scan(i, pointer(out.data(), 100'000), std::plus<long long>{}, pool);
+		assert(o.size() == 100'000);
+		// not partitionable
+		o = parallel::inclusive_scan(filter([](long long k) { return k % 2; }, take(iota(1LL), 10)), pointer(out.data(), n), std::plus<long long>{}, pool);
+		assert(equal(o, vector<long long>({ 1, 4, 9, 16, 25 })));
+		// not partitionable is one pass
+		int calls = 0;
+		auto f = filter([](long long k) { return k % 2; }, apply([&calls](long long k) { ++calls; return k; }, take(iota(1LL), 10)));
+		o = parallel::inclusive_scan(f, pointer(out.data(), 3), std::plus<long long>{}, pool);
+		assert(equal(o, vector<long long>({ 1, 4, 9 })));
+		assert(calls == 7); // up to the element after 5, once
+	}
+	{
+		std::vector<double> x(n);
+		for (std::size_t k = 0; k < n; ++k) {
+			x[k] = std::sin(double(k));
+		}
+		auto v = parallel::inclusive_scan(pointer(x.data(), n), std::plus<double>{}, pool);
+		auto s = inclusive_scan(std::plus<double>{}, pointer(x.data(), n));
+		for (std::size_t k = 0; k < n; ++k, ++s) {
+			assert(std::fabs(v[k] - *s) <= 1e-9);
+		}
+		auto u = parallel::inclusive_scan(make_interval(x), [](double a, double b) { return std::max(a, b); }, pool);
+		assert(u[n - 1] == *std::max_element(x.begin(), x.end()));
+	}
+
+	return 0;
+}
+
+int test_mmap_file()
+{
+	const auto path = std::filesystem::temp_directory_path() / "fms_iterable_mmap.t";
+	constexpr std::size_t n = 100'000;
+	std::vector<double> x(n);
+	for (std::size_t k = 0; k < n; ++k) {
+		x[k] = 0.25 * double(k);
+	}
+	{
+		FILE* fp = std::fopen(path.string().c_str(), "wb");
+		assert(fp);
+		std::fwrite(x.data(), sizeof(double), n, fp);
+		std::fclose(fp);
+	}
+	{
+		static_assert(sized<mmap_file<double>>);
+		static_assert(random_access<mmap_file<double>>);
+		static_assert(contiguous<mmap_file<double>>);
+
+		mmap_file<double> f(path, advice::sequential);
+		assert(f.size() == n);
+		assert(f[7] == x[7]);
+		assert(sum(f) == sum(make_interval(x)));
+		assert(equal(f, make_interval(x)));
+		assert(*back(f) == x.back());
+		auto g = drop(f, n - 3);
+		assert(equal(g, take(pointer(x.data() + n - 3), 3)));
+		assert(f.distance(g) == n - 3);
+		g.advise(advice::willneed).advise(advice::hugepage);
+		assert(make_vector(f > 1000.).size() == n - 4001);
+	}
+	{
+		// copies share the mapping
+		mmap_file<long long> g;
+		{
+			mmap_file<long long> f(path);
+			g = drop(f, 1);
+		}
+		assert(g.size() == n - 1);
+		long long y;
+		std::memcpy(&y, &x[1], sizeof(y));
+		assert(*g == y);
+	}
+	{
+		struct record { double t; float x; int i; };
+		static_assert(sizeof(record) == 16);
+		mmap_file<record> r(path);
+		assert(r.size() == n / 2);
+		assert(r[1].t == x[2]);
+	}
+	{
+		bool thrown = false;
+		try {
+			mmap_file<char[3]> f(path);
+		}
+		catch (const std::invalid_argument&) {
+			thrown = true;
+		}
+		assert(thrown);
+		thrown = false;
+		try {
+			mmap_file<double> f(path.string() + ".missing");
+		}
+		catch (const std::system_error& e) {
+			thrown = e.code() == std::errc::no_such_file_or_directory;
+		}
+		assert(thrown);
+	}
+	std::filesystem::remove(path);
+
+	return 0;
+}
+
+int test_parse()
+{
+	{
+		null_terminated_pointer<const char> s("x,y,z\n1,2.5,a\n-3,+4e1,b\n\n5,0.125,c");
+		auto x = column<int>(s, 0, ',', 1);
+		auto v = make_vector(x);
+		assert(v.size() == 3 && v[0] == 1 && v[1] == -3 && v[2] == 5);
+		auto y = column<double>(s, 1, ',', 1);
+		assert(sum(y) == 2.5 + 40 + 0.125);
+		auto xy = columns<int, double>(s, { 0, 1 }, ',', 1);
+		assert(*xy == std::tuple(1, 2.5));
+		++xy;
+		assert(*xy == std::tuple(-3, 40.));
+		// out of order and repeated columns
+		auto yx = columns<double, int, int>(s, { 1, 0, 0 }, ',', 1);
+		assert(*yx == std::tuple(2.5, 1, 1));
+	}
+	{
+		// whitespace and tab separated
+		null_terminated_pointer<const char> s("  1 \t 2\r\n3\t4\r\n");
+		auto x = columns<int, int>(s, { 1, 0 }, ' ');
+		assert(*x == std::tuple(2, 1));
+		assert(*++x == std::tuple(4, 3));
+		assert(!++x);
+		null_terminated_pointer<const char> t("1\t2\n3\t4\n");
+		int a[] = { 2, 4 };
+		assert(equal(column<int>(t, 1, '\t'), array(a)));
+	}
+	const auto path = std::filesystem::temp_directory_path() / "fms_iterable_parse.t";
+	constexpr int n = 10'000;
+	{
+		FILE* fp = std::fopen(path.string().c_str(), "wb");
+		assert(fp);
+		std::fputs("t,x\n", fp);
+		for (int k = 0; k < n; ++k) {
+			std::fprintf(fp, "%d,%g\n", k, 0.5 * k);
+		}
+		std::fclose(fp);
+	}
+	{
+		mmap_file<char> f(path, advice::sequential);
+		auto t = column<long>(f, 0, ',', 1);
+		assert(length(t) == n);
+		assert(sum(t) == long(n) * (n - 1) / 2);
+		auto tx = columns<int, double>(f, { 0, 1 }, ',', 1);
+		bool ok = true;
+		for (int k = 0; tx; ++tx, ++k) {
+			ok = ok && *tx == std::tuple(k, 0.5 * k);
+		}
+		assert(ok);
+	}
+#ifndef _WIN32
+	{
+		// small buffer to cross block boundaries and grow for long lines
+		int fd = ::open(path.c_str(), O_RDONLY);
+		assert(fd != -1);
+		auto x = column<double>(fd_reader(fd, 8), 1, ',', 1);
+		assert(sum(x) == 0.5 * n * (n - 1) / 2);
+		::close(fd);
+	}
+	{
+		// copies share the position in the stream
+		int fd = ::open(path.c_str(), O_RDONLY);
+		assert(fd != -1);
+		auto x = column<int>(fd_reader(fd, 8), 0, ',', 1);
+		auto y = x;
+		assert(*x == 0 && *y == 0);
+		++x;
+		assert(*x == 1 && *y == 0);
+		++y;
+		assert(*y == 2);
+		assert(*++x == 3);
+		::close(fd);
+	}
+#endif
+	std::filesystem::remove(path);
+	{
+		null_terminated_pointer<const char> s("1,2\n3\n");
+		bool thrown = false;
+		try {
+			auto x = column<int>(s, 1);
+			++x;
+		}
+		catch (const std::invalid_argument&) {
+			thrown = true;
+		}
+		assert(thrown);
+		// the whole field must be a number
+		auto invalid = [](const char* t, char delim) {
+			try {
+				column<int>(null_terminated_pointer<const char>(t), 0, delim);
+			}
+			catch (const std::invalid_argument&) {
+				return true;
+			}
+
+			return false;
+		};
+		assert(invalid("z,1\n", ','));
+		assert(invalid("12abc,1\n", ','));
+		assert(invalid("1\t2\n", ','));
+		assert(!invalid("12 ,1\n", ','));
+	}
+
+	return 0;
+}
+
+generator<long> fibonacci()
+{
+	long a = 0, b = 1;
+	for (;;) {
+		co_yield a;
+		a = std::exchange(b, a + b);
+	}
+}
+
+struct counting {
+	static inline int n = 0;
+	static void* allocate(std::size_t m)
+	{
+		++n;
+		return frame_pool::allocate(m);
+	}
+	static void deallocate(void* p, std::size_t m) noexcept
+	{
+		--n;
+		frame_pool::deallocate(p, m);
+	}
+};
+
+generator<int, counting> countdown(int k)
+{
+	while (k > 0) {
+		co_yield k--;
+	}
+}
+
+// arguments that could initialize promise members
+generator<int, counting> ints(const int* p, std::size_t n)
+{
+	for (std::size_t k = 0; k < n; ++k) {
+		co_yield p[k];
+	}
+}
+
+generator<int> throws(int k)
+{
+	co_yield k;
+	throw std::runtime_error("throws");
+}
+
+int test_generator()
+{
+	{
+		static_assert(input<generator<int>>);
+		auto f = fibonacci();
+		long a[] = { 0, 1, 1, 2, 3, 5, 8 };
+		assert(equal(take(f, 7), array(a)));
+		// copies share the coroutine and keep their current value
+		f = fibonacci();
+		auto g = f;
+		++g;
+		assert(*f == 0 && *g == 1);
+		++f;
+		assert(*f == 1);
+		++g;
+		assert(*g == 2);
+		assert(sum(take(fibonacci(), 10)) == 88);
+	}
+	{
+		auto g = generate(iota(1));
+		assert(sum(take(g, 4)) == 10);
+		auto v = std::vector<double>{ 1, 2, 3 };
+		assert(equal(generate(make_interval(v)), make_interval(v)));
+		assert(!generate(empty<int>()));
+		generator<int> e;
+		assert(!e);
+		assert(e == generator<int>{});
+	}
+	{
+		int s = 0;
+		for (auto k : countdown(4)) {
+			s += k;
+		}
+		assert(s == 10);
+		assert(counting::n == 0);
+		{
+			auto c = countdown(3);
+			assert(counting::n == 1);
+			auto d = c;
+			assert(counting::n == 1);
+			++d;
+			assert(*c == 3 && *d == 2);
+		}
+		assert(counting::n == 0);
+		int a[] = { 1, 2, 3 };
+		assert(equal(ints(a, 3), array(a)));
+		assert(counting::n == 0);
+	}
+	{
+		auto g = throws(1);
+		assert(*g == 1);
+		bool thrown = false;
+		try {
+			++g;
+		}
+		catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		assert(thrown);
+		assert(!g);
+	}
+	{
+		// frames are reused
+		void* p = frame_pool::allocate(100);
+		frame_pool::deallocate(p, 100);
+		assert(frame_pool::allocate(120) == p);
+		frame_pool::deallocate(p, 120);
+		long s = 0;
+		for (int k = 0; k < 1000; ++k) {
+			s += sum(generate(take(iota(0), 4)));
+		}
+		assert(s == 6000);
+	}
+	{
+		// a thread that only frees frames returns them at exit
+		void* p = frame_pool::allocate(100);
+		std::thread([p]() { frame_pool::deallocate(p, 100); }).join();
+	}
+	{
+		// free lists are capped
+		std::thread([]() {
+			constexpr auto n = frame_pool::depth + 1;
+			std::vector<void*> ps(n);
+			for (auto& p : ps) {
+				p = frame_pool::allocate(100);
+			}
+			for (auto p : ps) {
+				frame_pool::deallocate(p, 100);
+			}
+			auto a = allocations;
+			for (auto& p : ps) {
+				p = frame_pool::allocate(100);
+			}
+			assert(allocations - a == 1);
+			for (auto p : ps) {
+				frame_pool::deallocate(p, 100);
+			}
+		}).join();
+	}
+
+	return 0;
+}
+
+int test_prefetch()
+{
+	{
+		spsc<int> r(5);
+		assert(r.capacity() == 8);
+		int a[] = { 1, 2, 3, 4, 5, 6 }, b[8];
+		assert(r.push(a, 6));
+		assert(r.pop(b, 4) == 4 && b[3] == 4);
+		assert(r.push(a, 6)); // wraps
+		assert(r.pop(b, 8) == 8 && b[1] == 6 && b[2] == 1 && b[7] == 6);
+		r.close();
+		assert(r.pop(b, 8) == 0);
+	}
+	{
+		constexpr std::size_t n = 100'000;
+		std::vector<double> x(n);
+		for (std::size_t k = 0; k < n; ++k) {
+			x[k] = double(k);
+		}
+		auto p = prefetch(make_interval(x), 7);
+		assert(*p == 0);
+		assert(equal(p, make_interval(x)));
+		assert(sum(prefetch(pointer(x.data(), n))) == sum(make_interval(x)));
+		assert(sum(prefetch(apply([](double t) { return t * t; }, make_interval(x)), 100)) == sum(make_interval(x) * make_interval(x)));
+	}
+	{
+		// the consumer stops early on an infinite upstream
+		for (int k = 0; k < 10; ++k) {
+			assert(sum(take(prefetch(iota(1), 16), 100)) == 5050);
+		}
+		auto p = prefetch(until([](int k) { return k > 1000; }, iota(0)), 32);
+		assert(length(p) == 1001);
+		assert(!prefetch(empty<int>()));
+	}
+	{
+		// bool values
+		auto even = apply([](int k) { return k % 2 == 0; }, take(iota(0), 1000));
+		assert(equal(prefetch(even, 16), even));
+		assert(length(filter([](bool b) { return b; }, prefetch(even))) == 500);
+	}
+	{
+		// until over a single-pass source does not read past the stop element
+		std::vector<int> x(1000);
+		for (int k = 0; k < 1000; ++k) {
+			x[k] = (k * 37) % 101;
+		}
+		auto u = until([](int k) { return k == 10; }, prefetch(pointer(x.data(), x.size()), 16));
+		int b[300];
+		auto n = u.next_batch(std::span(b));
+		assert(x[n] == 10);
+		assert(std::equal(b, b + n, x.data()));
+		assert(!u);
+		auto c = concatenate(until([](int k) { return k == 10; }, prefetch(pointer(x.data(), x.size()), 16)), take(iota(0), 3));
+		assert(c.next_batch(std::span(b)) == n + 3);
+		assert(b[n] == 0 && b[n + 2] == 2);
+	}
+	{
+		bool thrown = false;
+		try {
+			auto p = prefetch(apply([](int k) { if (k == 50) throw std::runtime_error("prefetch"); return k; }, iota(0)));
+			while (p) {
+				++p;
+			}
+		}
+		catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	return 0;
+}
+
+template <class W>
+int test_channel_wait(long n)
+{
+	constexpr long producers = 4;
+	channel<long, W> c(64);
+	std::vector<std::thread> ps;
+	for (long p = 0; p < producers; ++p) {
+		ps.emplace_back([c, p, n]() {
+			// one element at a time and whole iterables
+			for (long k = 0; k < n / 2; ++k) {
+				c.push(p * n + k);
+			}
+			c.push(take(iota(p * n + n / 2), n / 2));
+		});
+	}
+	std::thread closer([&ps, c]() {
+		for (auto& p : ps) {
+			p.join();
+		}
+		c.close();
+	});
+	// two consumers
+	long s1 = 0, l1 = 0;
+	std::thread consumer([c, &s1, &l1]() {
+		for (auto k : c) {
+			s1 += k;
+			++l1;
+		}
+	});
+	auto l2 = length(c);
+	consumer.join();
+	closer.join();
+	assert(l1 + (long)l2 == n * producers);
+	(void)s1;
+	assert(!c);
+	assert(!c.push(1));
+
+	return 0;
+}
+
+int test_channel()
+{
+	{
+		mpmc<int> q(3);
+		assert(q.capacity() == 4);
+		int a[] = { 1, 2, 3, 4, 5 }, b[5];
+		assert(q.try_push(a, 5) == 4);
+		assert(q.try_push(a, 1) == 0);
+		assert(q.try_pop(b, 2) == 2 && b[0] == 1 && b[1] == 2);
+		assert(q.try_push(a + 4, 1) == 1);
+		assert(q.try_pop(b, 5) == 3 && b[0] == 3 && b[2] == 5);
+		assert(q.try_pop(b, 1) == 0);
+		q.close();
+		assert(q.pop(b, 1) == 0);
+	}
+	{
+		channel<double> c;
+		assert(c.push(take(iota(1.), 100)) == 100);
+		c.close();
+		auto d = c;
+		assert(*d == 1); // only read copies pop
+		assert(sum(c) == 5050 - 1);
+		assert(!c);
+	}
+	{
+		// values are converted to the channel type
+		channel<double> c(1024);
+		assert(c.push(take(iota(0), 300)) == 300);
+		assert(c.push(2.5f));
+		c.close();
+		assert(sum(c) == 299 * 150 + 2.5);
+	}
+	{
+		// until leaves the stop element in the channel
+		channel<int> c;
+		assert(c.push(apply([](int k) { return (k * 37) % 101; }, take(iota(0), 200))) == 200);
+		c.close();
+		auto u = until([](int k) { return k == 10; }, c);
+		int b[100];
+		auto n = u.next_batch(std::span(b));
+		assert(n == 3 && b[2] == 74);
+		assert(!u);
+		// u holds the stop element, the rest are still queued
+		assert(length(c) == 200 - n - 1);
+		assert(length(u) == 0);
+	}
+	{
+		// order is kept with one producer
+		channel<int> c(8);
+		std::thread p([c]() { c.push(take(iota(0), 1000)); c.close(); });
+		assert(equal(c, take(iota(0), 1000)));
+		p.join();
+	}
+	{
+		channel<int, wait::block> c(4);
+		std::thread p([c]() { c.push(take(iota(0), 1000)); c.close(); });
+		assert(sum(c) == 999 * 500);
+		p.join();
+	}
+	test_channel_wait<wait::spin>(100); // slow without a core per thread
+	test_channel_wait<wait::yield>(10'000);
+	test_channel_wait<wait::block>(10'000);
+
+	return 0;
+}
+
+int test_vector()
+{
+	{
+		auto v = make_vector(take(iota(0), 1000));
+		auto w = v++;
+		assert(*w == 0 && *v == 1);
+		assert(&*w.begin() == &*v.begin()); // copies share storage
+		auto r = repeat(take(v, 3));
+		assert(equal(take(r, 6), vector<int>({ 1, 2, 3, 1, 2, 3 })));
+	}
+	{
+		// build phase copies storage only when shared
+		vector<int> v({ 1, 2 });
+		auto w = v;
+		w.push_back(3).emplace_back(4);
+		assert(length(v) == 2 && length(w) == 4);
+		assert(v == v && !(v == w));
+	}
+	{
+		// moved from is empty and usable
+		vector<int> v({ 1, 2 });
+		auto w = std::move(v);
+		assert(!v && v.size() == 0 && length(w) == 2);
+		v.push_back(3);
+		assert(*v == 3 && v.size() == 1);
+		w = std::move(v);
+		assert(*w == 3 && !v);
+		// moves do not allocate
+		static_assert(std::is_nothrow_move_constructible_v<vector<int>>);
+		static_assert(std::is_nothrow_move_assignable_v<vector<int>>);
+		auto a = allocations;
+		auto u = std::move(w);
+		w = std::move(u);
+		assert(allocations == a);
+		assert(*w == 3 && !u);
+		u.push_back(4);
+		assert(*u == 4 && length(vector<int>(std::move(v))) == 0);
+	}
+	{
+		// sized sources allocate storage once
+		std::vector<double> x(1000, 1.);
+		auto a = allocations;
+		auto v = make_vector(pointer(x.data(), x.size()));
+		assert(allocations - a == 2); // shared_ptr control block and storage
+		assert(v.size() == 1000);
+		a = allocations;
+		auto w = make_vector(take(iota(0), 1000));
+		assert(allocations - a == 2);
+		assert(w.size() == 1000 && w[999] == 999);
+	}
+
+	return 0;
+}
+
+int test_memoize()
+{
+	{
+		int calls = 0;
+		auto m = memoize(apply([&calls](int k) { ++calls; return long(k) * k; }, iota(0)));
+		static_assert(unbounded<decltype(memoize(iota(0)))>);
+		assert(*m == 0 && calls == 1);
+		auto m2 = m;
+		assert(sum(take(m, 10)) == 285);
+		assert(calls == 10);
+		// copies re-traverse without recomputing
+		assert(sum(take(m2, 10)) == 285);
+		assert(calls == 10);
+		assert(m.cached() == 10);
+		++m2;
+		assert(*m2 == 1);
+		assert(sum(take(m2, 2000)) == sum(take(apply([](int k) { return long(k) * k; }, iota(1)), 2000)));
+		assert(calls == 2001);
+	}
+	{
+		auto e = memoize(power(1.) / factorial(0.));
+		auto s = sum(take(e, 20));
+		assert(s == sum(take(power(1.) / factorial(0.), 20)));
+		assert(sum(take(e, 20)) == s);
+	}
+	{
+		auto m = memoize(take(iota(0), 5));
+		static_assert(sized<decltype(m)>);
+		assert(m.size() == 5);
+		auto m2 = m;
+		++m2;
+		assert(m.size() == 5 && m2.size() == 4);
+		assert(equal(m, take(iota(0), 5)));
+		assert(equal(m2, take(iota(1), 4)));
+		assert(!memoize(empty<int>()));
+	}
+
+	return 0;
+}
+
+int test_any_iterable()
+{
+	{
+		std::vector<any_iterable<double>> v;
+		v.push_back(take(iota(1.), 4));
+		v.push_back(apply([](double t) { return t * t; }, take(iota(1.), 3)));
+		v.push_back(take(iota(1), 2)); // int values
+		v.push_back(empty<double>());
+		std::array<double, 100> big{};
+		big[0] = 7;
+		v.push_back(take(apply([big](double t) { return big[0] + t; }, iota(0.)), 300)); // on the heap
+		double s[] = { 10, 14, 3, 0, 7 * 300. + 299 * 150 };
+		for (std::size_t k = 0; k < v.size(); ++k) {
+			assert(sum(v[k]) == s[k]);
+		}
+		assert(!any_iterable<int>());
+	}
+	{
+		// copies are independent
+		any_iterable<int> a(take(iota(0), 1000));
+		auto b = a;
+		++a;
+		assert(*a == 1 && *b == 0);
+		auto c = std::move(b);
+		assert(*c == 0 && !b);
+		b = a;
+		assert(equal(b, take(iota(1), 999)));
+		assert(equal(a, take(iota(1), 999)));
+		int x[130];
+		assert(a.next_batch(std::span<int>(x, 130)) == 130 && x[129] == 130);
+		assert(*a == 131);
+		assert(length(a) == 1000 - 131);
+	}
+	{
+		// apply stores its source, not a cached copy of the source
+		struct loud {
+			double t;
+			loud(double t) : t(t) { }
+			loud(const loud& l) : t(l.t) { }
+			loud(loud&& l) noexcept(false) : t(l.t) { }
+			loud& operator=(const loud&) = default;
+		};
+		using P = pointer<double>;
+		using A = apply<loud(*)(double), P>;
+		static_assert(is_computed_v<A> && !std::is_nothrow_move_constructible_v<cached_t<A>>);
+		static_assert(std::is_nothrow_move_constructible_v<apply<double(*)(loud), A>>);
+	}
+	{
+		// adaptor pipelines are stored inline
+		std::vector<double> x{ 1, -2, 3, -4 };
+		auto n = allocations;
+		any_iterable<double> a(filter([](double t) { return t > 0; }, apply([](double t) { return 2 * t; }, pointer(x.data(), x.size()))));
+		auto b = std::move(a);
+		any_iterable<double> c(until([](double t) { return t > 3; }, pointer(x.data(), x.size()) > 0.));
+		assert(allocations == n);
+		assert(sum(b) == 8);
+		assert(sum(c) == 4);
+	}
+
+	return 0;
+}
+
+int test_layout()
+{
+	// stateless functors take no space
+	using P = pointer<double>;
+	auto sq = [](double t) { return t * t; };
+	auto pos = [](double t) { return t > 0; };
+	static_assert(sizeof(apply<decltype(sq), P>) == sizeof(P));
+	static_assert(sizeof(filter<decltype(pos), P>) == sizeof(P));
+	static_assert(sizeof(until<decltype(pos), P>) == sizeof(P));
+	static_assert(sizeof(binop<std::plus<double>, P, P>) == 2 * sizeof(P));
+	static_assert(sizeof(fold<std::plus<double>, P>) == sizeof(P) + sizeof(double));
+	static_assert(sizeof(delta<P>) == sizeof(P) + 2 * sizeof(double));
+	// distinct empty members of the same type cannot share an address
+	auto neg = [](double t) { return t < 0; };
+	using A = apply<decltype(sq), until<decltype(neg), P>>;
+	using Q = take<filter<decltype(pos), A>>;
+	// filter caches the computed element it tested, a value and a flag more than A
+	static_assert(sizeof(A) == sizeof(P));
+	static_assert(sizeof(cached<A>) > sizeof(A));
+	static_assert(sizeof(Q) == sizeof(cached<A>) + sizeof(std::size_t));
+	{
+		double x[] = { 1, 2, -3 };
+		double y[] = { 1, 4 };
+		Q q(filter(std::move(pos), apply(sq, until(neg, P(x, 3)))), 2);
+		assert(equal(q, P(y, 2)));
+	}
+
+	return 0;
+}
+
+int test_cached()
+{
+	int calls = 0;
+	auto sq = [&calls](int t) { ++calls; return t * t; };
+	{
+		auto c = cached(apply(sq, iota(1)));
+		assert(*c == 1 && *c == 1 && calls == 1);
+		++c;
+		assert(*c == 4 && *c == 4 && calls == 2);
+		int x[4];
+		assert(c.next_batch(std::span<int>(x, 4)) == 4 && x[0] == 4 && x[3] == 25);
+		assert(calls == 5 && *c == 36);
+	}
+	{
+		calls = 0;
+		auto f = filter([](int t) { return t % 2 == 0; }, apply(sq, iota(1)));
+		assert(equal(take(f, 3), take(apply([](int t) { return 4 * t * t; }, iota(1)), 3)));
+		assert(calls == 8); // 1, ..., 8 once each
+	}
+	{
+		calls = 0;
+		auto u = until([](int t) { return t > 10; }, apply(sq, iota(1)));
+		assert(length(u) == 3);
+		assert(calls == 4);
+		// batches do not read past the stop element
+		calls = 0;
+		auto v = until([](int t) { return t > 10; }, apply(sq, iota(1)));
+		static_assert(batched<decltype(v)> && multi_pass<apply<decltype(sq), iota<int>>>);
+		int z[8];
+		assert(v.next_batch(std::span(z)) == 3 && z[2] == 9);
+		assert(!v);
+		assert(calls == 4);
+	}
+	{
+		calls = 0;
+		auto d = delta(apply(sq, iota(1)));
+		assert(equal(take(d, 3), take(apply([](int t) { return 2 * t + 1; }, iota(1)), 3)));
+		assert(calls == 4);
+	}
+	{
+		calls = 0;
+		auto m = merge(apply(sq, iota(0)), apply(sq, iota(1)));
+		int y[] = { 0, 1, 1, 4, 4, 9 };
+		assert(equal(take(m, 6), array(y)));
+		assert(calls == 8); // 0, ..., 16 and 1, 4, 9
+	}
+
+	return 0;
+}
+
+int test_rolling()
+{
+	double x[] = { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9 };
+	constexpr std::size_t N = std::size(x);
+	for (std::size_t n : { 1, 3, 4, 20 }) {
+		auto s = rolling_sum(pointer(x, N), n);
+		auto m = rolling_mean(pointer(x, N), n);
+		auto v = rolling_variance(pointer(x, N), n);
+		auto lo = rolling_min(pointer(x, N), n);
+		auto hi = rolling_max(pointer(x, N), n);
+		for (std::size_t k = 0; k < N; ++k) {
+			auto b = k + 1 >= n ? k + 1 - n : 0;
+			auto c = static_cast<double>(k + 1 - b);
+			double s_ = 0, v_ = 0;
+			for (auto j = b; j <= k; ++j) {
+				s_ += x[j];
+			}
+			for (auto j = b; j <= k; ++j) {
+				v_ += (x[j] - s_ / c) * (x[j] - s_ / c);
+			}
+			v_ = c > 1 ? v_ / (c - 1) : 0;
+			assert(s && *s == s_);
+			assert(m && std::fabs(*m - s_ / c) < 1e-12);
+			assert(v && std::fabs(*v - v_) < 1e-12);
+			assert(lo && *lo == *std::min_element(x + b, x + k + 1));
+			assert(hi && *hi == *std::max_element(x + b, x + k + 1));
+			++s, ++m, ++v, ++lo, ++hi;
+		}
+		assert(!s && !m && !v && !lo && !hi);
+	}
+	{
+		// blocks agree with one at a time
+		auto i = apply([](int k) { return double((k * 7919) % 101); }, take(iota(0), 1000));
+		assert(equal(rolling_max(i, 17), make_vector(rolling_max(i, 17))));
+		std::vector<double> a(1000);
+		auto r = rolling_sum(i, 5);
+		assert(r.next_batch(std::span(a.data(), 300)) == 300);
+		assert(r.next_batch(std::span(a.data() + 300, 700)) == 700);
+		assert(equal(pointer(a.data(), a.size()), rolling_sum(i, 5)));
+	}
+	{
+		double t[] = { 0, 1, 1.5, 2, 4, 4.5, 10 };
+		double y[] = { 1, 2, 3, 4, 5, 6, 7 };
+		// window (t - 2, t]
+		double s[] = { 1, 3, 6, 9, 5, 11, 7 };
+		auto r = make_rolling_time<window::sum<double>>(pair(pointer(t, 7), pointer(y, 7)), 2.);
+		for (std::size_t k = 0; k < 7; ++k, ++r) {
+			assert(r && (*r).first == t[k] && (*r).second == s[k]);
+		}
+		assert(!r);
+	}
+
+	return 0;
+}
+
+int test_recurrence()
+{
+	{
+		double x[] = { 1, 0, 0, 0, 0, 0 };
+		double f[] = { 1, 1, 2, 3, 5, 8 };
+		assert(equal(recurrence<2, 1, pointer<double>>({ 1, 1 }, { 1 }, pointer(x, 6)), pointer(f, 6)));
+		double s[] = { 1, 1, 0, 0, 0, 0 };
+		assert(equal(recurrence<0, 2, pointer<double>>({}, { 1, 1 }, pointer(x, 6)), pointer(s, 6)));
+	}
+	{
+		auto i = apply([](int k) { return double((k * 7919) % 101); }, take(iota(0), 1000));
+		double a = 0.1;
+		auto e = ewma(a, i);
+		auto v = ewm_variance(a, i);
+		double m = *i, w = 0;
+		for (auto j = i; j; ++j) {
+			auto d = *j - m;
+			m += a * d;
+			w = (1 - a) * (w + a * d * d);
+			assert(std::fabs(*e - m) < 1e-12);
+			assert(std::fabs(*v - w) < 1e-12 && std::fabs(v.mean() - m) < 1e-12);
+			++e;
+			++v;
+		}
+		assert(!e && !v);
+	}
+	{
+		constexpr std::size_t R = 50, M = 3;
+		double x[R * M];
+		for (std::size_t k = 0; k < R * M; ++k) {
+			x[k] = double((k * 31) % 17);
+		}
+		auto rows = apply([&x](std::size_t r) { return std::span<const double>(x + r * M, M); }, take(iota<std::size_t>(0), R));
+		for (std::size_t c = 0; c < M; ++c) {
+			auto col = apply([&x, c](std::size_t r) { return x[r * M + c]; }, take(iota<std::size_t>(0), R));
+			auto e = ewma_columns(0.2, rows, M);
+			auto f = ewma(0.2, col);
+			while (e) {
+				assert(f && std::fabs((*e)[c] - *f) < 1e-12);
+				++e;
+				++f;
+			}
+			assert(!f);
+			auto g = recurrence_columns<2, 2, decltype(rows)>({ 0.5, 0.25 }, { 1, -1 }, rows, M);
+			auto h = recurrence<2, 2, decltype(col)>({ 0.5, 0.25 }, { 1, -1 }, col);
+			while (g) {
+				assert(h && std::fabs((*g)[c] - *h) < 1e-12);
+				++g;
+				++h;
+			}
+			assert(!h);
+		}
+	}
+	{
+		// integer data is averaged in the type of alpha
+		int a[] = { 0, 4, 4, 4 };
+		double y[] = { 0, 2, 3, 3.5 };
+		assert(equal(ewma(0.5, pointer<const int>(a, 4)), pointer(y, 4)));
+		auto v = ewm_variance(0.5, pointer<const int>(a, 4));
+		++v;
+		assert(*v == 4 && v.mean() == 2);
+	}
+	{
+		double x[] = { 1, 2, 3 };
+		std::span<const double> r[] = { { x, 2 }, { x, 1 } };
+		auto e = ewma_columns(0.5, pointer(r, 2), 2);
+		bool thrown = false;
+		try {
+			++e;
+		}
+		catch (const std::invalid_argument&) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	return 0;
+}
+
+int test_asof_join()
+{
+	using P = std::pair<double, int>;
+	const auto key = [](const P& p) { return p.first; };
+	P q[] = { {1, 10}, {2, 20}, {2, 21}, {5, 50}, {9, 90} }; // quotes
+	P t[] = { {0, 0}, {1, 1}, {2, 2}, {3, 3}, {8.5, 4}, {9, 5}, {12, 6} }; // trades
+	// brute force index of match or -1
+	const auto match = [&](double k, bool forward, double tol) {
+		int j = -1;
+		for (int i = 0; i < 5; ++i) {
+			if (forward ? q[i].first >= k && j < 0 : q[i].first <= k) {
+				j = i;
+			}
+		}
+		if (j >= 0 && std::fabs(q[j].first - k) > tol) {
+			j = -1;
+		}
+		return j;
+	};
+	const auto check = [&](auto a, bool forward, double tol) {
+		for (std::size_t i = 0; i < 7; ++i, ++a) {
+			assert(a);
+			auto [l, r] = *a;
+			assert(l == t[i]);
+			auto j = match(t[i].first, forward, tol);
+			assert(j < 0 ? !r : r && *r == q[j]);
+		}
+		assert(!a);
+	};
+	// not random access
+	const auto all = [](auto i) { return filter([](const P&) { return true; }, i); };
+	const double inf = std::numeric_limits<double>::infinity();
+	// galloping over pointer and one step at a time over filter
+	check(asof_join(pointer(t, 7), pointer(q, 5), key), false, inf);
+	check(asof_join(pointer(t, 7), all(pointer(q, 5)), key), false, inf);
+	check(asof_join(pointer(t, 7), pointer(q, 5), key, 1.), false, 1.);
+	check(asof_join(pointer(t, 7), all(pointer(q, 5)), key, 1.), false, 1.);
+	check(asof_join_forward(pointer(t, 7), pointer(q, 5), key), true, inf);
+	check(asof_join_forward(pointer(t, 7), all(pointer(q, 5)), key), true, inf);
+	check(asof_join_forward(pointer(t, 7), pointer(q, 5), key, 0.5), true, 0.5);
+	{
+		// sparse left over dense right
+		std::vector<int> r(10000);
+		std::iota(r.begin(), r.end(), 0);
+		int l[] = { -1, 0, 17, 18, 5000, 9998, 20000 };
+		int m[] = { -1, 0, 17, 18, 5000, 9998, 9999 };
+		auto a = asof_join(pointer(l, 7), pointer(r.data(), r.size()));
+		for (std::size_t i = 0; i < 7; ++i, ++a) {
+			assert(m[i] < 0 ? !(*a).second : *(*a).second == m[i]);
+		}
+		assert(!a);
+	}
+
+	return 0;
+}
+
 int main()
 {
 	test_interval();
@@ -691,6 +2322,28 @@ int main()
 	test_call();
 	test_exp();
 	test_pair();
+	test_batch();
+	test_simd();
+	test_accumulator();
+	test_parallel();
+	test_random_access();
+	test_sized();
+	test_simplify();
+	test_filter_simd();
+	test_scan();
+	test_mmap_file();
+	test_parse();
+	test_generator();
+	test_prefetch();
+	test_channel();
+	test_vector();
+	test_memoize();
+	test_any_iterable();
+	test_layout();
+	test_cached();
+	test_rolling();
+	test_recurrence();
+	test_asof_join();
 
 	return 0;
 }
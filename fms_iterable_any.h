@@ -0,0 +1,228 @@
+// fms_iterable_any.h - type erased iterable
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// Any iterable with values convertible to T.
+	// Iterables of at most N bytes are stored inline, larger ones on the heap.
+	// Values are pulled through one virtual call per block of B elements.
+	template <class T, std::size_t N = 64, std::size_t B = 64>
+	class any_iterable {
+		struct vtable {
+			void (*copy)(void* to, const void* from);
+			void (*move)(void* to, void* from) noexcept;
+			void (*destroy)(void* p) noexcept;
+			std::size_t (*pull)(void* p, std::span<T> s);
+		};
+
+		template <class I>
+		static constexpr bool small = sizeof(I) <= N && alignof(I) <= alignof(std::max_align_t)
+			&& std::is_nothrow_move_constructible_v<I>;
+
+		// inline or pointer to heap
+		template <class I>
+		static I& get(void* p) noexcept
+		{
+			if constexpr (small<I>) {
+				return *std::launder(static_cast<I*>(p));
+			}
+			else {
+				return **static_cast<I**>(p);
+			}
+		}
+		template <class I>
+		static constexpr vtable table = {
+			[](void* to, const void* from) {
+				auto& i = get<I>(const_cast<void*>(from));
+				if constexpr (small<I>) {
+					::new(to) I(i);
+				}
+				else {
+					*static_cast<I**>(to) = new I(i);
+				}
+			},
+			[](void* to, void* from) noexcept {
+				if constexpr (small<I>) {
+					::new(to) I(std::move(get<I>(from)));
+					get<I>(from).~I();
+				}
+				else {
+					*static_cast<I**>(to) = *static_cast<I**>(from);
+				}
+			},
+			[](void* p) noexcept {
+				if constexpr (small<I>) {
+					get<I>(p).~I();
+				}
+				else {
+					delete &get<I>(p);
+				}
+			},
+			[](void* p, std::span<T> s) {
+				if constexpr (std::is_same_v<typename I::value_type, T>) {
+					return iterable::next_batch(get<I>(p), s);
+				}
+				else {
+					auto& i = get<I>(p);
+					std::size_t n = 0;
+					while (n < s.size() && i) {
+						s[n++] = static_cast<T>(*i);
+						++i;
+					}
+
+					return n;
+				}
+			}
+		};
+
+		alignas(std::max_align_t) std::byte buf[std::max(N, sizeof(void*))];
+		const vtable* vt;
+		std::array<T, B> b; // values [k, n) pulled but not consumed
+		std::size_t k, n;
+
+		void fill()
+		{
+			k = 0;
+			n = vt ? vt->pull(buf, std::span<T>(b)) : 0;
+		}
+		void reset() noexcept
+		{
+			if (vt) {
+				vt->destroy(buf);
+				vt = nullptr;
+			}
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using reference = const T&;
+		using difference_type = std::ptrdiff_t;
+
+		// Empty.
+		any_iterable() noexcept
+			: vt(nullptr), k(0), n(0)
+		{ }
+		template <input I>
+			requires (!std::is_same_v<std::remove_cvref_t<I>, any_iterable> && std::is_convertible_v<typename I::value_type, T>)
+		any_iterable(I i)
+			: vt(&table<I>)
+		{
+			if constexpr (small<I>) {
+				::new(static_cast<void*>(buf)) I(std::move(i));
+			}
+			else {
+				*reinterpret_cast<I**>(buf) = new I(std::move(i));
+			}
+			try {
+				fill();
+			}
+			catch (...) {
+				reset();
+				throw;
+			}
+		}
+		any_iterable(const any_iterable& a)
+			: vt(nullptr), b(a.b), k(a.k), n(a.n)
+		{
+			if (a.vt) {
+				a.vt->copy(buf, a.buf);
+				vt = a.vt;
+			}
+		}
+		any_iterable(any_iterable&& a) noexcept
+			: vt(nullptr), b(std::move(a.b)), k(a.k), n(a.n)
+		{
+			if (a.vt) {
+				a.vt->move(buf, a.buf);
+				vt = std::exchange(a.vt, nullptr);
+			}
+			a.k = a.n = 0;
+		}
+		any_iterable& operator=(const any_iterable& a)
+		{
+			if (this != &a) {
+				any_iterable t(a);
+				*this = std::move(t);
+			}
+
+			return *this;
+		}
+		any_iterable& operator=(any_iterable&& a) noexcept
+		{
+			if (this != &a) {
+				reset();
+				if (a.vt) {
+					a.vt->move(buf, a.buf);
+					vt = std::exchange(a.vt, nullptr);
+				}
+				b = std::move(a.b);
+				k = a.k;
+				n = a.n;
+				a.k = a.n = 0;
+			}
+
+			return *this;
+		}
+		~any_iterable()
+		{
+			reset();
+		}
+
+		// Both exhausted or the same object. Copies do not share state.
+		bool operator==(const any_iterable& a) const
+		{
+			return operator bool() ? this == &a : !a;
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return k < n;
+		}
+		reference operator*() const noexcept
+		{
+			return b[k];
+		}
+		any_iterable& operator++()
+		{
+			if (k < n && ++k == n && n == B) {
+				fill();
+			}
+
+			return *this;
+		}
+		any_iterable operator++(int)
+		{
+			auto a{ *this };
+
+			operator++();
+
+			return a;
+		}
+
+		std::size_t next_batch(std::span<value_type> s)
+		{
+			auto m = std::min({ s.size(), n - k, B - k });
+			std::copy_n(b.data() + k, m, s.data());
+			k += m;
+			if (m < s.size() && n == B) {
+				// pull straight into s then refill
+				m += vt->pull(buf, s.subspan(m));
+				fill();
+			}
+			else if (k == n && n == B) {
+				fill();
+			}
+
+			return m;
+		}
+	};
+
+} // namespace fms::iterable
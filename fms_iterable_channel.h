@@ -0,0 +1,385 @@
+// fms_iterable_channel.h - bounded lock free multi producer multi consumer channel
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// How a channel waits for space or elements.
+	// wait(ready) returns once ready() is true. notify() is called after every change.
+	namespace wait {
+
+		inline void pause() noexcept
+		{
+#ifdef FMS_SIMD_X86
+			_mm_pause();
+#endif
+		}
+
+		// Busy wait. Lowest latency, burns a core.
+		struct spin {
+			template <class F>
+			void wait(F&& ready) noexcept(noexcept(ready()))
+			{
+				while (!ready()) {
+					pause();
+				}
+			}
+			void notify() noexcept
+			{ }
+		};
+
+		// Spin then give up the time slice.
+		struct yield {
+			static constexpr int spins = 64;
+
+			template <class F>
+			void wait(F&& ready) noexcept(noexcept(ready()))
+			{
+				for (int k = 0; !ready(); ++k) {
+					if (k < spins) {
+						pause();
+					}
+					else {
+						std::this_thread::yield();
+					}
+				}
+			}
+			void notify() noexcept
+			{ }
+		};
+
+		// Spin then sleep until notified. Notify is one load when nobody sleeps.
+		struct block {
+			static constexpr int spins = 64;
+			std::atomic<std::uint32_t> epoch = 0;
+			std::atomic<std::uint32_t> sleepers = 0;
+
+			template <class F>
+			void wait(F&& ready)
+			{
+				for (int k = 0; k < spins; ++k) {
+					if (ready()) {
+						return;
+					}
+					pause();
+				}
+				for (;;) {
+					sleepers.fetch_add(1, std::memory_order_seq_cst);
+					auto e = epoch.load(std::memory_order_seq_cst);
+					if (ready()) {
+						sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+						return;
+					}
+					epoch.wait(e, std::memory_order_seq_cst);
+					sleepers.fetch_sub(1, std::memory_order_relaxed);
+				}
+			}
+			void notify() noexcept
+			{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (sleepers.load(std::memory_order_relaxed)) {
+					epoch.fetch_add(1, std::memory_order_seq_cst);
+					epoch.notify_all();
+				}
+			}
+		};
+
+	} // namespace wait
+
+	// Bounded queue of cells with sequence numbers. Any thread may push or pop.
+	// Pop returns elements in the order their pushes claimed positions.
+	template <class T, class W = wait::yield>
+	class mpmc {
+		static constexpr std::size_t line = 64;
+
+		struct cell {
+			std::atomic<std::size_t> seq;
+			T t;
+		};
+		std::unique_ptr<cell[]> buf;
+		std::size_t mask;
+		alignas(line) std::atomic<std::size_t> enq;
+		alignas(line) std::atomic<std::size_t> deq;
+		alignas(line) std::atomic<bool> done;
+		W w;
+
+		// signed difference of positions
+		static std::ptrdiff_t diff(std::size_t a, std::size_t b) noexcept
+		{
+			return static_cast<std::ptrdiff_t>(a - b);
+		}
+	public:
+		// Capacity is rounded up to a power of 2.
+		explicit mpmc(std::size_t capacity)
+			: buf(std::make_unique<cell[]>(std::bit_ceil(std::max<std::size_t>(capacity, 2)))),
+			  mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1), enq(0), deq(0), done(false)
+		{
+			for (std::size_t k = 0; k <= mask; ++k) {
+				buf[k].seq.store(k, std::memory_order_relaxed);
+			}
+		}
+		mpmc(const mpmc&) = delete;
+		mpmc& operator=(const mpmc&) = delete;
+
+		std::size_t capacity() const noexcept
+		{
+			return mask + 1;
+		}
+
+		// No more pushes. Pops drain what is left.
+		void close() noexcept
+		{
+			done.store(true, std::memory_order_release);
+			w.notify();
+		}
+		bool closed() const noexcept
+		{
+			return done.load(std::memory_order_acquire);
+		}
+
+		// Push up to n elements from p without waiting. Return the number pushed.
+		std::size_t try_push(const T* p, std::size_t n)
+		{
+			auto pos = enq.load(std::memory_order_relaxed);
+			for (;;) {
+				// free cells are those a full lap behind
+				std::size_t m = 0;
+				while (m < n && m <= mask && buf[(pos + m) & mask].seq.load(std::memory_order_acquire) == pos + m) {
+					++m;
+				}
+				if (m == 0) {
+					auto seq = buf[pos & mask].seq.load(std::memory_order_acquire);
+					if (diff(seq, pos) < 0) {
+						return 0; // full
+					}
+					pos = enq.load(std::memory_order_relaxed);
+
+					continue;
+				}
+				if (enq.compare_exchange_weak(pos, pos + m, std::memory_order_relaxed)) {
+					for (std::size_t k = 0; k < m; ++k) {
+						auto& c = buf[(pos + k) & mask];
+						c.t = p[k];
+						c.seq.store(pos + k + 1, std::memory_order_release);
+					}
+					w.notify();
+
+					return m;
+				}
+			}
+		}
+		// Pop up to n elements into p without waiting. Return the number popped.
+		std::size_t try_pop(T* p, std::size_t n)
+		{
+			auto pos = deq.load(std::memory_order_relaxed);
+			for (;;) {
+				// full cells are one ahead
+				std::size_t m = 0;
+				while (m < n && m <= mask && buf[(pos + m) & mask].seq.load(std::memory_order_acquire) == pos + m + 1) {
+					++m;
+				}
+				if (m == 0) {
+					auto seq = buf[pos & mask].seq.load(std::memory_order_acquire);
+					if (diff(seq, pos + 1) < 0) {
+						return 0; // empty
+					}
+					pos = deq.load(std::memory_order_relaxed);
+
+					continue;
+				}
+				if (deq.compare_exchange_weak(pos, pos + m, std::memory_order_relaxed)) {
+					for (std::size_t k = 0; k < m; ++k) {
+						auto& c = buf[(pos + k) & mask];
+						p[k] = std::move(c.t);
+						c.seq.store(pos + k + mask + 1, std::memory_order_release);
+					}
+					w.notify();
+
+					return m;
+				}
+			}
+		}
+
+		// Push all of [p, p + n), waiting for space. Return the number pushed, less than n if closed.
+		std::size_t push(const T* p, std::size_t n)
+		{
+			std::size_t m = 0;
+			w.wait([&]() {
+				if (closed()) {
+					return true;
+				}
+				m += try_push(p + m, n - m);
+
+				return m == n;
+			});
+
+			return m;
+		}
+		bool push(const T& t)
+		{
+			return push(&t, 1) == 1;
+		}
+		// Pop between 1 and n elements into p, waiting for them.
+		// Return 0 only if closed and drained.
+		std::size_t pop(T* p, std::size_t n)
+		{
+			std::size_t m = 0;
+			if (n) {
+				w.wait([&]() {
+					if ((m = try_pop(p, n))) {
+						return true;
+					}
+					// pushes before close are visible so look once more
+					return closed() && (m = try_pop(p, n), true);
+				});
+			}
+
+			return m;
+		}
+	};
+
+	// Handle to a shared mpmc queue. Copies share the queue.
+	// Push elements or whole iterables on any thread, close when done.
+	// Receiving is an input iterable that waits for elements and ends when closed and drained.
+	// Each copy keeps the value it last advanced to and pops nothing until it is read.
+	template <class T, class W = wait::yield>
+	class channel {
+		std::shared_ptr<mpmc<T, W>> q;
+		mutable T t;
+		mutable bool loaded, ok;
+
+		struct ended {};
+		channel(ended) noexcept
+			: t{}, loaded(true), ok(false)
+		{ }
+
+		void load() const
+		{
+			if (!loaded) {
+				ok = q && q->pop(&t, 1) == 1;
+				loaded = true;
+			}
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using reference = const T&;
+		using difference_type = std::ptrdiff_t;
+
+		explicit channel(std::size_t capacity = 1 << 12)
+			: q(std::make_shared<mpmc<T, W>>(capacity)), t{}, loaded(false), ok(false)
+		{ }
+
+		// For range based for loops.
+		channel begin() const
+		{
+			return *this;
+		}
+		channel end() const
+		{
+			return channel(ended{});
+		}
+
+		mpmc<T, W>& queue() const noexcept
+		{
+			return *q;
+		}
+		void close() const noexcept
+		{
+			q->close();
+		}
+
+		// Send one element. Return false if closed.
+		bool push(const T& u) const
+		{
+			return q->push(u);
+		}
+		// Send all of i in batches. Return the number sent, less than length(i) if closed.
+		// Values of other types are converted one block at a time.
+		template <input I, class U = typename I::value_type>
+			requires std::is_convertible_v<U, T>
+		std::size_t push(I i) const
+		{
+			std::array<T, batch_size> a;
+			[[maybe_unused]] std::array<U, std::is_same_v<U, T> ? 0 : batch_size> u;
+			std::size_t n = 0;
+			for (;;) {
+				std::size_t m;
+				if constexpr (std::is_same_v<U, T>) {
+					m = iterable::next_batch(i, std::span<T>(a));
+				}
+				else {
+					m = iterable::next_batch(i, std::span<U>(u));
+					std::transform(u.begin(), u.begin() + m, a.begin(), [](const U& x) { return static_cast<T>(x); });
+				}
+				auto k = q->push(a.data(), m);
+				n += k;
+				if (k < m || m < a.size()) {
+					return n;
+				}
+			}
+		}
+
+		// Both ended or the same queue.
+		bool operator==(const channel& c) const
+		{
+			return operator bool() ? q == c.q : !c;
+		}
+
+		explicit operator bool() const
+		{
+			load();
+
+			return ok;
+		}
+		reference operator*() const
+		{
+			load();
+
+			return t;
+		}
+		channel& operator++()
+		{
+			load();
+			loaded = false;
+
+			return *this;
+		}
+		channel operator++(int)
+		{
+			load();
+			auto c{ *this };
+			operator++();
+
+			return c;
+		}
+
+		std::size_t next_batch(std::span<value_type> s)
+		{
+			std::size_t n = 0;
+			if (!s.empty() && operator bool()) {
+				s[n++] = t;
+				loaded = false;
+			}
+			while (n < s.size() && ok) {
+				auto m = q->pop(s.data() + n, s.size() - n);
+				ok = m != 0;
+				n += m;
+			}
+
+			return n;
+		}
+	};
+
+} // namespace fms::iterable
@@ -0,0 +1,266 @@
+// fms_iterable_generator.h - coroutine generator iterable with pooled frames
+#pragma once
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// Coroutine frames from operator new.
+	struct new_delete {
+		static void* allocate(std::size_t n)
+		{
+			return ::operator new(n);
+		}
+		static void deallocate(void* p, std::size_t n) noexcept
+		{
+			::operator delete(p, n);
+		}
+	};
+
+	// Per thread free lists of coroutine frames in multiples of quantum bytes.
+	// Frames larger than quantum*classes use operator new.
+	// A frame may be freed on a different thread than it was allocated on.
+	// It then goes on the freeing thread's list, so each list is capped at
+	// depth frames and frames past that are returned to operator delete.
+	class frame_pool {
+	public:
+		static constexpr std::size_t quantum = 64;
+		static constexpr std::size_t classes = 32;
+		static constexpr std::size_t depth = 64;
+	private:
+		struct node {
+			node* next;
+		};
+		// trivially destructible so access needs no guard
+		static inline thread_local node* free[classes] = {};
+		static inline thread_local std::size_t count[classes] = {};
+		static inline thread_local bool dead = false;
+		// return the free lists to operator delete at thread exit
+		struct reaper {
+			~reaper()
+			{
+				for (auto& f : free) {
+					while (f) {
+						::operator delete(std::exchange(f, f->next));
+					}
+				}
+				dead = true;
+			}
+		};
+		// one per thread that puts frames on a free list
+		static void reap()
+		{
+			thread_local reaper r;
+		}
+	public:
+		static void* allocate(std::size_t n)
+		{
+			auto c = (n + quantum - 1) / quantum;
+			if (c > classes) {
+				return ::operator new(n);
+			}
+			// pooled sizes are always whole classes since any thread may free them
+			if (dead) {
+				return ::operator new(c * quantum);
+			}
+			auto& f = free[c - 1];
+			if (f) {
+				--count[c - 1];
+
+				return std::exchange(f, f->next);
+			}
+			reap(); // only on the slow path
+
+			return ::operator new(c * quantum);
+		}
+		static void deallocate(void* p, std::size_t n) noexcept
+		{
+			auto c = (n + quantum - 1) / quantum;
+			if (c > classes || dead || count[c - 1] == depth) {
+				::operator delete(p);
+
+				return;
+			}
+			reap(); // threads that only free frames also own free lists
+			auto& f = free[c - 1];
+			f = ::new(p) node{ f };
+			++count[c - 1];
+		}
+	};
+
+	// Values produced by co_yield in a coroutine returning generator<T>.
+	// The body runs on first access. Copies share the coroutine and each
+	// copy keeps the value it last advanced to, like std::istream_iterator.
+	// A must provide static allocate(n) and deallocate(p, n) for the frame.
+	template <class T, class A = frame_pool>
+	class generator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using reference = const T&;
+		using difference_type = std::ptrdiff_t;
+
+		struct promise_type {
+			const T* p = nullptr;
+			std::size_t refs = 1;
+			bool started = false;
+
+			// not an aggregate so coroutine arguments do not initialize members
+			promise_type() noexcept
+			{ }
+
+			generator get_return_object() noexcept
+			{
+				return generator(handle::from_promise(*this));
+			}
+			std::suspend_always initial_suspend() const noexcept
+			{
+				return {};
+			}
+			std::suspend_always final_suspend() const noexcept
+			{
+				return {};
+			}
+			// t lives until the coroutine resumes
+			std::suspend_always yield_value(const T& t) noexcept
+			{
+				p = std::addressof(t);
+
+				return {};
+			}
+			void return_void() const noexcept
+			{ }
+			void unhandled_exception() const
+			{
+				throw;
+			}
+
+			static void* operator new(std::size_t n)
+			{
+				return A::allocate(n);
+			}
+			static void operator delete(void* q, std::size_t n) noexcept
+			{
+				A::deallocate(q, n);
+			}
+		};
+	private:
+		using handle = std::coroutine_handle<promise_type>;
+		handle h;
+		mutable T t; // value when this copy was last advanced
+		mutable bool loaded;
+
+		explicit generator(handle h) noexcept
+			: h(h), t{}, loaded(false)
+		{ }
+		// run to the first co_yield
+		void start() const
+		{
+			if (h && !h.promise().started) {
+				h.promise().started = true;
+				h.resume();
+			}
+		}
+		void load() const
+		{
+			if (!loaded) {
+				start();
+				if (h && !h.done()) {
+					t = *h.promise().p;
+				}
+				loaded = true;
+			}
+		}
+	public:
+		// Empty generator.
+		generator() noexcept
+			: h(nullptr), t{}, loaded(true)
+		{ }
+		generator(const generator& g)
+			: h(g.h), t((g.load(), g.t)), loaded(true)
+		{
+			if (h) {
+				++h.promise().refs;
+			}
+		}
+		generator(generator&& g) noexcept
+			: h(std::exchange(g.h, nullptr)), t(std::move(g.t)), loaded(g.loaded)
+		{ }
+		generator& operator=(generator g) noexcept
+		{
+			std::swap(h, g.h);
+			std::swap(t, g.t);
+			std::swap(loaded, g.loaded);
+
+			return *this;
+		}
+		~generator()
+		{
+			if (h && --h.promise().refs == 0) {
+				h.destroy();
+			}
+		}
+
+		// For range based for loops.
+		generator begin() const
+		{
+			return *this;
+		}
+		generator end() const
+		{
+			return generator{};
+		}
+
+		// Both exhausted or the same coroutine.
+		bool operator==(const generator& g) const
+		{
+			return operator bool() ? h == g.h : !g;
+		}
+
+		explicit operator bool() const
+		{
+			load();
+
+			return h && !h.done();
+		}
+		reference operator*() const
+		{
+			load();
+
+			return t;
+		}
+		generator& operator++()
+		{
+			if (operator bool()) {
+				h.resume();
+				loaded = false;
+			}
+
+			return *this;
+		}
+		generator operator++(int)
+		{
+			auto g{ *this };
+
+			operator++();
+
+			return g;
+		}
+	};
+
+	// Values of any iterable as a coroutine.
+	template <class A = frame_pool, input I, class T = typename I::value_type>
+	inline generator<T, A> generate(I i)
+	{
+		while (i) {
+			co_yield *i;
+			++i;
+		}
+	}
+
+} // namespace fms::iterable
@@ -0,0 +1,152 @@
+// fms_iterable_join.h - join sorted iterables on a key
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// For each element l of sorted left, the pair {l, r} where r is the last element
+	// of sorted right with key(r) <= key(l), or the first with key(r) >= key(l) if forward.
+	// r is empty if there is none or key(l) and key(r) differ by more than the tolerance.
+	// The right cursor only moves forward. If right is random access and sized it gallops,
+	// so a sparse left side skips runs of right in logarithmic time.
+	template <input L, input R, class K = std::identity, bool forward = false,
+		class LT = typename L::value_type, class RT = typename R::value_type>
+	class asof_join {
+		using D = decltype(std::declval<const K&>()(std::declval<const LT&>()) - std::declval<const K&>()(std::declval<const RT&>()));
+
+		L l;
+		R r; // first right element not yet passed
+		FMS_NO_UNIQUE_ADDRESS K key;
+		std::optional<D> tol;
+		std::optional<RT> last; // last right element passed
+		std::optional<RT> m; // match for *l
+
+		// Pass the prefix of r satisfying p, keeping the last one if not forward.
+		template <class P>
+		void pass(const P& p)
+		{
+			if constexpr (random_access<R> && sized<R>) {
+				std::size_t n = r.size();
+				if (n == 0 || !p(r[0])) {
+					return;
+				}
+				// p(r[lo]) holds and fails at hi or hi == n
+				std::size_t lo = 0, step = 1;
+				while (lo + step < n && p(r[static_cast<typename R::difference_type>(lo + step)])) {
+					lo += step;
+					step *= 2;
+				}
+				auto hi = std::min(lo + step, n);
+				while (hi - lo > 1) {
+					auto mid = lo + (hi - lo) / 2;
+					(p(r[static_cast<typename R::difference_type>(mid)]) ? lo : hi) = mid;
+				}
+				if constexpr (!forward) {
+					last = r[static_cast<typename R::difference_type>(lo)];
+				}
+				r += static_cast<typename R::difference_type>(lo + 1);
+			}
+			else {
+				while (r && p(*r)) {
+					if constexpr (!forward) {
+						last = *r;
+					}
+					++r;
+				}
+			}
+		}
+		void seek()
+		{
+			m.reset();
+			if (!l) {
+				return;
+			}
+			const auto& u = *l;
+			auto k = key(u);
+			if constexpr (forward) {
+				pass([&](const RT& t) { return key(t) < k; });
+				if (r) {
+					m = *r;
+				}
+			}
+			else {
+				pass([&](const RT& t) { return !(k < key(t)); });
+				m = last;
+			}
+			if (m && tol) {
+				auto d = forward ? key(*m) - k : k - key(*m);
+				if (*tol < d) {
+					m.reset();
+				}
+			}
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::pair<LT, std::optional<RT>>;
+		using difference_type = typename L::difference_type;
+
+		static constexpr bool infinite = unbounded<L>;
+
+		asof_join(const L& l, const R& r, const K& key = K{}, std::optional<D> tol = std::nullopt)
+			: l(l), r(r), key(key), tol(tol)
+		{
+			seek();
+		}
+
+		bool operator==(const asof_join& a) const
+		{
+			return l == a.l && r == a.r;
+		}
+
+		explicit operator bool() const
+		{
+			return l.operator bool();
+		}
+		value_type operator*() const
+		{
+			return { *l, m };
+		}
+		asof_join& operator++()
+		{
+			if (l) {
+				++l;
+				seek();
+			}
+
+			return *this;
+		}
+		asof_join operator++(int)
+		{
+			auto a{ *this };
+
+			operator++();
+
+			return a;
+		}
+
+		std::size_t size() const
+			requires sized<L>
+		{
+			return l.size();
+		}
+	};
+
+	// First right element at or after each left element.
+	template <input L, input R, class K = std::identity>
+	inline auto asof_join_forward(const L& l, const R& r, const K& key = K{})
+	{
+		return asof_join<L, R, K, true>(l, r, key);
+	}
+	template <input L, input R, class K, class D>
+	inline auto asof_join_forward(const L& l, const R& r, const K& key, D tol)
+	{
+		return asof_join<L, R, K, true>(l, r, key, tol);
+	}
+
+} // namespace fms::iterable
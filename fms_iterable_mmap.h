@@ -0,0 +1,281 @@
+// fms_iterable_mmap.h - read only memory mapped file of fixed width records
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include "fms_iterable.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fms::iterable {
+
+	// Access pattern hints for the pages of a mapping.
+	enum class advice { normal, sequential, random, willneed, hugepage };
+
+	// Read only view of a whole file. Unmapped on destruction.
+	class mapping {
+		const std::byte* p;
+		std::size_t n;
+#ifdef _WIN32
+		HANDLE f, m;
+#endif
+	public:
+		explicit mapping(const std::filesystem::path& path)
+			: p(nullptr), n(0)
+		{
+#ifdef _WIN32
+			f = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (f == INVALID_HANDLE_VALUE) {
+				throw std::system_error(GetLastError(), std::system_category(), path.string());
+			}
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(f, &size)) {
+				auto e = GetLastError();
+				CloseHandle(f);
+				throw std::system_error(e, std::system_category(), path.string());
+			}
+			n = static_cast<std::size_t>(size.QuadPart);
+			m = nullptr;
+			if (n) {
+				m = CreateFileMappingW(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (m) {
+					p = static_cast<const std::byte*>(MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0));
+				}
+				if (!p) {
+					auto e = GetLastError();
+					if (m) {
+						CloseHandle(m);
+					}
+					CloseHandle(f);
+					throw std::system_error(e, std::system_category(), path.string());
+				}
+			}
+#else
+			int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd == -1) {
+				throw std::system_error(errno, std::generic_category(), path.string());
+			}
+			struct stat st;
+			if (::fstat(fd, &st) == -1) {
+				auto e = errno;
+				::close(fd);
+				throw std::system_error(e, std::generic_category(), path.string());
+			}
+			n = static_cast<std::size_t>(st.st_size);
+			if (n) {
+				void* q = ::mmap(nullptr, n, PROT_READ, MAP_SHARED, fd, 0);
+				if (q == MAP_FAILED) {
+					auto e = errno;
+					::close(fd);
+					throw std::system_error(e, std::generic_category(), path.string());
+				}
+				p = static_cast<const std::byte*>(q);
+			}
+			::close(fd); // the mapping keeps the file open
+#endif
+		}
+		mapping(const mapping&) = delete;
+		mapping& operator=(const mapping&) = delete;
+		~mapping()
+		{
+#ifdef _WIN32
+			if (p) {
+				UnmapViewOfFile(p);
+			}
+			if (m) {
+				CloseHandle(m);
+			}
+			CloseHandle(f);
+#else
+			if (p) {
+				::munmap(const_cast<std::byte*>(p), n);
+			}
+#endif
+		}
+
+		const std::byte* data() const noexcept
+		{
+			return p;
+		}
+		std::size_t size() const noexcept
+		{
+			return n;
+		}
+
+		// Hint how bytes [off, off + len) will be used. Hints the OS lacks are ignored.
+		void advise(advice a, std::size_t off = 0, std::size_t len = std::size_t(-1)) const
+		{
+			if (!p || off >= n) {
+				return;
+			}
+			len = std::min(len, n - off);
+#ifdef _WIN32
+			if (a == advice::willneed) {
+				WIN32_MEMORY_RANGE_ENTRY r{ const_cast<std::byte*>(p + off), len };
+				PrefetchVirtualMemory(GetCurrentProcess(), 1, &r, 0);
+			}
+#else
+			// madvise needs a page aligned address
+			auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+			auto lo = off / page * page;
+			auto q = const_cast<std::byte*>(p + lo);
+			len += off - lo;
+			int h;
+			switch (a) {
+			case advice::sequential:
+				h = MADV_SEQUENTIAL;
+				break;
+			case advice::random:
+				h = MADV_RANDOM;
+				break;
+			case advice::willneed:
+				h = MADV_WILLNEED;
+				break;
+			case advice::hugepage:
+#ifdef MADV_HUGEPAGE
+				h = MADV_HUGEPAGE;
+				break;
+#else
+				return;
+#endif
+			default:
+				h = MADV_NORMAL;
+			}
+			if (::madvise(q, len, h) == -1 && errno != EINVAL) {
+				throw std::system_error(errno, std::generic_category(), "madvise");
+			}
+#endif
+		}
+	};
+
+	// Records of a file as a sized, random access, contiguous iterable.
+	// Copies share the mapping.
+	template <class T>
+		requires std::is_trivially_copyable_v<T>
+	class mmap_file {
+		std::shared_ptr<const mapping> m;
+		const T* p;
+		std::size_t n;
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using reference = const T&;
+		using difference_type = std::ptrdiff_t;
+
+		mmap_file()
+			: p(nullptr), n(0)
+		{ }
+		explicit mmap_file(const std::filesystem::path& path, advice a = advice::normal)
+			: m(std::make_shared<const mapping>(path)), p(reinterpret_cast<const T*>(m->data())), n(m->size() / sizeof(T))
+		{
+			if (m->size() % sizeof(T)) {
+				throw std::invalid_argument("mmap_file: file size is not a multiple of the record size");
+			}
+			if (a != advice::normal) {
+				m->advise(a);
+			}
+		}
+
+		bool operator==(const mmap_file& f) const
+		{
+			return p == f.p && n == f.n;
+		}
+
+		// Hint for the remaining records.
+		const mmap_file& advise(advice a) const
+		{
+			if (m) {
+				m->advise(a, reinterpret_cast<const std::byte*>(p) - m->data(), n * sizeof(T));
+			}
+
+			return *this;
+		}
+		const T* data() const noexcept
+		{
+			return p;
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return n != 0;
+		}
+		reference operator*() const noexcept
+		{
+			return *p;
+		}
+		mmap_file& operator++() noexcept
+		{
+			if (n) {
+				++p;
+				--n;
+			}
+
+			return *this;
+		}
+		mmap_file operator++(int) noexcept
+		{
+			auto f{ *this };
+
+			operator++();
+
+			return f;
+		}
+
+		std::size_t size() const noexcept
+		{
+			return n;
+		}
+		mmap_file& operator+=(difference_type k) noexcept
+		{
+			auto k_ = std::min(static_cast<std::size_t>(k), n);
+			p += k_;
+			n -= k_;
+
+			return *this;
+		}
+		reference operator[](difference_type k) const noexcept
+		{
+			return p[k];
+		}
+		difference_type distance(const mmap_file& f) const noexcept
+		{
+			return f.p - p;
+		}
+
+		std::size_t next_batch(std::span<value_type> s) noexcept
+		{
+			auto k = std::min(n, s.size());
+			std::copy_n(p, k, s.data());
+			p += k;
+			n -= k;
+
+			return k;
+		}
+		std::span<const value_type> next_span(std::size_t k) noexcept
+		{
+			k = std::min(n, k);
+			std::span<const value_type> s(p, k);
+			p += k;
+			n -= k;
+
+			return s;
+		}
+	};
+
+} // namespace fms::iterable
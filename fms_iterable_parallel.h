@@ -0,0 +1,257 @@
+// fms_iterable_parallel.h - parallel reductions and scans over sized, advanceable iterables
+#pragma once
+#include <execution>
+#include <optional>
+#include <vector>
+#include "fms_iterable.h"
+#include "fms_thread_pool.h"
+
+namespace fms::iterable::parallel {
+
+	// Split into chunks that can be reached in O(1).
+	template <class I>
+	concept partitionable = sized<I> && advanceable<I>;
+
+	// Minimum number of elements per chunk.
+	inline constexpr std::size_t grain = 1 << 14;
+
+	// Chunk boundaries [0, m, 2m, ..., n) with m a multiple of align.
+	inline std::size_t chunk_size(std::size_t n, const thread_pool& pool, std::size_t align = 1)
+	{
+		auto chunks = 4 * (pool.size() + 1); // for load balance
+		auto m = std::max(grain, (n + chunks - 1) / chunks);
+
+		return (m + align - 1) / align * align;
+	}
+
+	// Elements [k*m, min(n, (k + 1)*m)) of i.
+	template <partitionable I>
+	inline auto chunk(I i, std::size_t k, std::size_t m)
+	{
+		i += static_cast<typename I::difference_type>(k * m);
+
+		return take(i, m);
+	}
+
+	// op(...op(op(t, i[0]), i[1])..., i[n-1]) with chunks reduced concurrently then combined in order.
+	// Op must be associative.
+	template <input I, class T = typename I::value_type, class Op = std::plus<T>>
+	inline T reduce(I i, T t = 0, Op op = {}, thread_pool& pool = default_thread_pool())
+	{
+		const auto seq = [&op](auto j, T u) {
+			while (j) {
+				u = op(u, *j);
+				++j;
+			}
+
+			return u;
+		};
+
+		if constexpr (partitionable<I>) {
+			auto n = i.size();
+			auto m = chunk_size(n, pool);
+			auto chunks = (n + m - 1) / m;
+			if (chunks > 1) {
+				std::vector<T> u(chunks);
+				pool.run(chunks, [&](std::size_t k) {
+					auto j = chunk(i, k, m);
+					u[k] = *j;
+					u[k] = seq(++j, u[k]);
+				});
+				for (const auto& u_ : u) {
+					t = op(t, u_);
+				}
+
+				return t;
+			}
+		}
+
+		return seq(i, t);
+	}
+
+	// Parallel sum using SIMD lanes in each chunk.
+	// Reproducible sums are bit-identical to the sequential result for any number of threads.
+	template <simd::summation S = simd::summation::fast, input I, class T = typename I::value_type>
+	inline T sum(I i, T t = 0, thread_pool& pool = default_thread_pool())
+	{
+		if constexpr (partitionable<I>) {
+			auto n = i.size();
+
+			if constexpr (S == simd::summation::reproducible && std::is_floating_point_v<T>) {
+				using accumulator = simd::accumulator<T, S>;
+				constexpr auto B = accumulator::block;
+
+				// value of every block in the order of the sequential sum
+				auto m = chunk_size(n, pool, B);
+				auto chunks = (n + m - 1) / m;
+				std::vector<T> v((n + B - 1) / B);
+				pool.run(chunks, [&](std::size_t k) {
+					auto j = chunk(i, k, m);
+					for (auto b = k * m / B; j; ++b) {
+						accumulator a;
+						auto j_ = take(j, B);
+						if constexpr (contiguous<decltype(j_)>) {
+							auto s = j_.next_span(B);
+							a.add(s.data(), s.size());
+						}
+						else {
+							for_each_batch(j_, [&a](auto s) { a.add(s.data(), s.size()); });
+						}
+						v[b] = a.lane_value();
+						j += static_cast<typename I::difference_type>(B);
+					}
+				});
+				accumulator a(t);
+				for (const auto& v_ : v) {
+					a.add_block(v_);
+				}
+
+				return a.value();
+			}
+			else {
+				auto m = chunk_size(n, pool);
+				auto chunks = (n + m - 1) / m;
+				if (chunks > 1) {
+					std::vector<T> u(chunks);
+					pool.run(chunks, [&](std::size_t k) {
+						u[k] = iterable::sum<S>(chunk(i, k, m), T(0));
+					});
+					for (const auto& u_ : u) {
+						t += u_;
+					}
+
+					return t;
+				}
+			}
+		}
+
+		return iterable::sum<S>(i, t);
+	}
+
+	// Running reduction of i into out using two passes over chunks.
+	// The first pass reduces each chunk, the second scans each chunk from the
+	// reduction of all previous chunks. Op must be associative.
+	// Exclusive scans start with the initial value c.
+	// Return the part of out that was written.
+	template <bool inclusive, input I, class T, class Op>
+	inline pointer<T> scan(I i, pointer<T> out, std::optional<T> c, Op op, thread_pool& pool)
+	{
+		// scan at most m elements of j into o and return the number written
+		const auto seq = [&op](auto j, std::optional<T> u, T* o, std::size_t m) {
+			std::size_t k = 0;
+			for (; k < m && j; ++k, ++j) {
+				if constexpr (inclusive) {
+					u = u ? op(*u, *j) : T(*j);
+					o[k] = *u;
+				}
+				else {
+					o[k] = *u;
+					u = op(*u, *j);
+				}
+			}
+
+			return k;
+		};
+		auto o = &*out;
+
+		if constexpr (partitionable<I>) {
+			auto n = std::min<std::size_t>(i.size(), out.size());
+			auto m = chunk_size(n, pool);
+			auto chunks = (n + m - 1) / m;
+			if (chunks > 1) {
+				// first pass: reduction of each chunk but the last
+				std::vector<T> u(chunks - 1);
+				pool.run(chunks - 1, [&](std::size_t k) {
+					auto j = chunk(i, k, m);
+					if constexpr (simd::elementwise<Op, T> && std::is_floating_point_v<T>
+						&& (simd::op_of<Op, T>() == simd::op::add || simd::op_of<Op, T>() == simd::op::mul)) {
+						constexpr auto O = simd::op_of<Op, T>();
+						simd::accumulator<T, simd::summation::fast, O> a(O == simd::op::add ? T(0) : T(1));
+						if constexpr (contiguous<decltype(j)>) {
+							auto s = j.next_span(m);
+							a.add(s.data(), s.size());
+						}
+						else {
+							for_each_batch(j, [&a](auto s) { a.add(s.data(), s.size()); });
+						}
+						u[k] = a.value();
+					}
+					else {
+						T t = *j;
+						while (++j) {
+							t = op(t, *j);
+						}
+						u[k] = t;
+					}
+				});
+				// carry into each chunk
+				std::vector<std::optional<T>> carry(chunks);
+				carry[0] = c;
+				for (std::size_t k = 0; k + 1 < chunks; ++k) {
+					carry[k + 1] = carry[k] ? op(*carry[k], u[k]) : u[k];
+				}
+				// second pass
+				pool.run(chunks, [&](std::size_t k) {
+					seq(chunk(i, k, m), carry[k], o + k * m, std::min(m, n - k * m));
+				});
+
+				return pointer<T>(o, n);
+			}
+		}
+
+		// one pass so single pass sources and upstream functors are not run twice
+		auto n = seq(i, c, o, out.size());
+
+		return pointer<T>(o, n);
+	}
+
+	// op(...op(i[0], i[1])..., i[k]) in out[k].
+	template <input I, class T, class Op = std::plus<T>>
+	inline pointer<T> inclusive_scan(I i, pointer<T> out, Op op = {}, thread_pool& pool = default_thread_pool())
+	{
+		return scan<true>(i, out, std::optional<T>{}, op, pool);
+	}
+	template <input I, class Op = std::plus<typename I::value_type>, class T = typename I::value_type>
+	inline vector<T> inclusive_scan(I i, Op op = {}, thread_pool& pool = default_thread_pool())
+	{
+		static_assert(sized<I>, "inclusive_scan: materializing requires a sized iterable");
+		std::vector<T> v(i.size());
+		parallel::inclusive_scan(i, pointer<T>(v.data(), v.size()), op, pool);
+
+		return vector<T>(std::move(v));
+	}
+
+	// op(...op(t, i[0])..., i[k - 1]) in out[k].
+	template <input I, class T, class Op = std::plus<T>>
+	inline pointer<T> exclusive_scan(I i, pointer<T> out, T t, Op op = {}, thread_pool& pool = default_thread_pool())
+	{
+		return scan<false>(i, out, std::optional<T>(t), op, pool);
+	}
+	template <input I, class T, class Op = std::plus<T>>
+	inline vector<T> exclusive_scan(I i, T t, Op op = {}, thread_pool& pool = default_thread_pool())
+	{
+		static_assert(sized<I>, "exclusive_scan: materializing requires a sized iterable");
+		std::vector<T> v(i.size());
+		parallel::exclusive_scan(i, pointer<T>(v.data(), v.size()), t, op, pool);
+
+		return vector<T>(std::move(v));
+	}
+
+} // namespace fms::iterable::parallel
+
+namespace fms::iterable {
+
+	// Sum using an execution policy. Parallel policies use the default thread pool.
+	template <simd::summation S = simd::summation::fast, class E, input I, class T = typename I::value_type>
+		requires std::is_execution_policy_v<std::remove_cvref_t<E>>
+	inline auto sum(I i, T t, E&&)
+	{
+		if constexpr (std::is_same_v<std::remove_cvref_t<E>, std::execution::sequenced_policy>) {
+			return sum<S>(i, t);
+		}
+		else {
+			return parallel::sum<S>(i, t);
+		}
+	}
+
+} // namespace fms::iterable
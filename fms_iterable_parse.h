@@ -0,0 +1,282 @@
+// fms_iterable_parse.h - parse numeric columns of delimited text
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "fms_iterable.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fms::iterable {
+
+	// Blocks of whole lines. Empty only when exhausted.
+	template <class S>
+	concept line_source = requires(S s) {
+		{ s.next_lines() } -> std::same_as<std::span<const char>>;
+	};
+
+	// Read a file descriptor through a large buffer. Copies share the stream.
+	class fd_reader {
+		struct state {
+			int fd;
+			std::vector<char> buf;
+			std::size_t b, e; // unread [b, e)
+			bool eof;
+		};
+		std::shared_ptr<state> s;
+	public:
+		// Does not own fd.
+		explicit fd_reader(int fd, std::size_t size = 1 << 20)
+			: s(std::make_shared<state>(state{ fd, std::vector<char>(size), 0, 0, false }))
+		{ }
+
+		// Invalidates the previous block.
+		std::span<const char> next_lines()
+		{
+			auto& [fd, buf, b, e, eof] = *s;
+
+			for (;;) {
+				std::memmove(buf.data(), buf.data() + b, e - b);
+				e -= b;
+				b = 0;
+				while (!eof && e < buf.size()) {
+#ifdef _WIN32
+					auto r = ::_read(fd, buf.data() + e, static_cast<unsigned>(std::min<std::size_t>(buf.size() - e, 1u << 30)));
+#else
+					auto r = ::read(fd, buf.data() + e, buf.size() - e);
+#endif
+					if (r < 0) {
+						if (errno == EINTR) {
+							continue;
+						}
+						throw std::system_error(errno, std::generic_category(), "fd_reader");
+					}
+					if (r == 0) {
+						eof = true;
+					}
+					e += static_cast<std::size_t>(r);
+				}
+
+				auto q = e;
+				if (!eof) { // end after the last newline
+					while (q > 0 && buf[q - 1] != '\n') {
+						--q;
+					}
+				}
+				if (q > 0 || eof) {
+					b = q;
+
+					return std::span<const char>(buf.data(), q);
+				}
+				buf.resize(2 * buf.size()); // line longer than the buffer
+			}
+		}
+	};
+
+	// Numeric fields of each line of delimited text using std::from_chars.
+	// A space delimiter splits on runs of spaces and tabs. Blank lines are skipped.
+	// The source is a line_source or a contiguous iterable of char.
+	// Blocks of a line_source are invalidated by the next read so copies share the
+	// position and each copy keeps the value it last advanced to, like std::istream_iterator.
+	template <class S, class... Ts>
+		requires (sizeof...(Ts) > 0)
+	class parse {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::conditional_t<sizeof...(Ts) == 1, std::tuple_element_t<0, std::tuple<Ts...>>, std::tuple<Ts...>>;
+		using difference_type = std::ptrdiff_t;
+		static constexpr std::size_t N = sizeof...(Ts);
+	private:
+		struct cursor {
+			const char* p = nullptr; // next line
+			const char* e = nullptr; // end of block
+		};
+		S s;
+		std::conditional_t<line_source<S>, std::shared_ptr<cursor>, cursor> c;
+		std::array<std::size_t, N> col;
+		std::size_t last; // largest column
+		char delim;
+		bool ok;
+		value_type v;
+
+		static bool space(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+		template <class T>
+		static void number(const char* b, const char* f, T& t)
+		{
+			while (b < f && (space(*b) || *b == '+')) {
+				++b;
+			}
+			auto [q, ec] = std::from_chars(b, f, t);
+			while (q < f && space(*q)) {
+				++q;
+			}
+			if (ec != std::errc{} || q != f) {
+				throw std::invalid_argument("parse: invalid number");
+			}
+		}
+		cursor& at()
+		{
+			if constexpr (line_source<S>) {
+				return *c;
+			}
+			else {
+				return c;
+			}
+		}
+		std::span<const char> block()
+		{
+			if constexpr (line_source<S>) {
+				return s.next_lines();
+			}
+			else {
+				return s.next_span(static_cast<std::size_t>(-1));
+			}
+		}
+		// Find the next non-blank line and parse its columns.
+		void next()
+		{
+			auto& [p, e] = at();
+			for (;;) {
+				if (p == e) {
+					auto b = block();
+					if (b.empty()) {
+						ok = false;
+
+						return;
+					}
+					p = b.data();
+					e = p + b.size();
+				}
+				auto nl = static_cast<const char*>(std::memchr(p, '\n', e - p));
+				auto eol = nl ? nl : e;
+				auto b = p;
+				p = nl ? nl + 1 : e;
+				while (b < eol && space(*b)) {
+					++b;
+				}
+				if (b == eol) {
+					continue;
+				}
+
+				// field boundaries of the requested columns
+				std::array<std::pair<const char*, const char*>, N> f;
+				for (std::size_t j = 0; j <= last; ++j) {
+					if (b > eol) {
+						throw std::invalid_argument("parse: missing column");
+					}
+					const char* q;
+					if (delim == ' ') {
+						while (b < eol && space(*b)) {
+							++b;
+						}
+						q = b;
+						while (q < eol && !space(*q)) {
+							++q;
+						}
+					}
+					else {
+						q = static_cast<const char*>(std::memchr(b, delim, eol - b));
+						if (!q) {
+							q = eol;
+						}
+					}
+					for (std::size_t k = 0; k < N; ++k) {
+						if (col[k] == j) {
+							f[k] = { b, q };
+						}
+					}
+					b = q + 1;
+				}
+				if constexpr (N == 1) {
+					number(f[0].first, f[0].second, v);
+				}
+				else {
+					[&]<std::size_t... K>(std::index_sequence<K...>) {
+						(number(f[K].first, f[K].second, std::get<K>(v)), ...);
+					}(std::make_index_sequence<N>{});
+				}
+				ok = true;
+
+				return;
+			}
+		}
+	public:
+		// Columns are zero based. Skip header lines before parsing.
+		parse(const S& s, const std::array<std::size_t, N>& col, char delim = ',', std::size_t header = 0)
+			: s(s), c{}, col(col), last(*std::max_element(col.begin(), col.end())), delim(delim), ok(false), v{}
+		{
+			if constexpr (line_source<S>) {
+				c = std::make_shared<cursor>();
+			}
+			auto& [p, e] = at();
+			while (header--) {
+				if (p == e) {
+					auto b = block();
+					if (b.empty()) {
+						return;
+					}
+					p = b.data();
+					e = p + b.size();
+				}
+				auto nl = static_cast<const char*>(std::memchr(p, '\n', e - p));
+				p = nl ? nl + 1 : e;
+			}
+			next();
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return ok;
+		}
+		value_type operator*() const
+		{
+			return v;
+		}
+		parse& operator++()
+		{
+			if (ok) {
+				next();
+			}
+
+			return *this;
+		}
+		parse operator++(int)
+		{
+			auto q{ *this };
+
+			operator++();
+
+			return q;
+		}
+	};
+
+	// One column as T.
+	template <class T, class S>
+	inline auto column(const S& s, std::size_t col = 0, char delim = ',', std::size_t header = 0)
+	{
+		return parse<S, T>(s, { col }, delim, header);
+	}
+	// std::tuple<Ts...> of columns.
+	template <class... Ts, class S>
+	inline auto columns(const S& s, const std::array<std::size_t, sizeof...(Ts)>& col, char delim = ',', std::size_t header = 0)
+	{
+		return parse<S, Ts...>(s, col, delim, header);
+	}
+
+} // namespace fms::iterable
@@ -0,0 +1,260 @@
+// fms_iterable_prefetch.h - run an iterable on a worker thread
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <span>
+#include <thread>
+#include <utility>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// Bounded lock free ring with one producer thread and one consumer thread.
+	// Positions count up forever and the top bit marks the end of each side.
+	template <class T>
+	class spsc {
+		static constexpr std::size_t flag = std::size_t(1) << (8 * sizeof(std::size_t) - 1);
+		static constexpr std::size_t line = 64;
+
+		std::unique_ptr<T[]> buf;
+		std::size_t mask;
+		alignas(line) std::atomic<std::size_t> head; // consumer position, flag when stopped
+		alignas(line) std::atomic<std::size_t> tail; // producer position, flag when closed
+
+		// copy n elements from p to ring position k, or from k to p
+		void put(std::size_t k, const T* p, std::size_t n)
+		{
+			auto m = std::min(n, mask + 1 - (k & mask));
+			std::copy_n(p, m, buf.get() + (k & mask));
+			std::copy_n(p + m, n - m, buf.get());
+		}
+		void get(std::size_t k, T* p, std::size_t n) const
+		{
+			auto m = std::min(n, mask + 1 - (k & mask));
+			std::copy_n(buf.get() + (k & mask), m, p);
+			std::copy_n(buf.get(), n - m, p + m);
+		}
+	public:
+		// Capacity is rounded up to a power of 2.
+		explicit spsc(std::size_t capacity)
+			: buf(std::make_unique<T[]>(std::bit_ceil(std::max<std::size_t>(capacity, 1)))),
+			  mask(std::bit_ceil(std::max<std::size_t>(capacity, 1)) - 1), head(0), tail(0)
+		{ }
+		spsc(const spsc&) = delete;
+		spsc& operator=(const spsc&) = delete;
+
+		std::size_t capacity() const noexcept
+		{
+			return mask + 1;
+		}
+
+		// Producer: copy all of [p, p + n), waiting for space.
+		// Return false if the consumer stopped.
+		bool push(const T* p, std::size_t n)
+		{
+			auto t = tail.load(std::memory_order_relaxed);
+			while (n) {
+				auto h = head.load(std::memory_order_acquire);
+				if (h & flag) {
+					return false;
+				}
+				auto m = std::min(n, capacity() - (t - h));
+				if (m == 0) {
+					head.wait(h, std::memory_order_acquire);
+
+					continue;
+				}
+				put(t, p, m);
+				t += m;
+				tail.store(t, std::memory_order_release);
+				tail.notify_one();
+				p += m;
+				n -= m;
+			}
+
+			return true;
+		}
+		// Producer: no more elements.
+		void close() noexcept
+		{
+			tail.fetch_or(flag, std::memory_order_release);
+			tail.notify_one();
+		}
+
+		// Consumer: copy between 1 and n elements to p, waiting for the producer.
+		// Return 0 only if closed and empty.
+		std::size_t pop(T* p, std::size_t n)
+		{
+			auto h = head.load(std::memory_order_relaxed);
+			for (;;) {
+				auto t = tail.load(std::memory_order_acquire);
+				auto m = std::min(n, (t & ~flag) - h);
+				if (m) {
+					get(h, p, m);
+					head.store(h + m, std::memory_order_release);
+					head.notify_one();
+
+					return m;
+				}
+				if (t & flag || n == 0) {
+					return 0;
+				}
+				tail.wait(t, std::memory_order_acquire);
+			}
+		}
+		// Consumer: no more elements wanted.
+		void stop() noexcept
+		{
+			head.fetch_or(flag, std::memory_order_release);
+			head.notify_one();
+		}
+	};
+
+	// Elements of i computed on a worker thread and passed through a ring of capacity elements.
+	// The worker waits when the ring is full and exits when the last copy is destroyed,
+	// after its current call into i returns. Exceptions thrown by i are rethrown on increment.
+	// Copies share the worker and each copy keeps the value it last advanced to.
+	template <input I, class T = typename I::value_type>
+	class prefetch {
+		struct state {
+			spsc<T> ring;
+			std::exception_ptr e;
+			std::size_t size; // of consumer block
+			std::unique_ptr<T[]> b; // consumer block [k, n)
+			std::size_t k, n;
+			std::thread worker;
+
+			state(I i, std::size_t capacity)
+				: ring(capacity), size(std::clamp<std::size_t>(capacity / 4, 1, batch_size)), b(std::make_unique<T[]>(size)), k(0), n(0)
+			{
+				worker = std::thread([this, i]() mutable {
+					try {
+						auto a = std::make_unique<T[]>(size);
+						for (;;) {
+							auto m = iterable::next_batch(i, std::span<T>(a.get(), size));
+							if (!ring.push(a.get(), m) || m < size) {
+								break;
+							}
+						}
+					}
+					catch (...) {
+						e = std::current_exception();
+					}
+					ring.close();
+				});
+			}
+			state(const state&) = delete;
+			state& operator=(const state&) = delete;
+			~state()
+			{
+				ring.stop();
+				worker.join();
+			}
+
+			// Next element into t. Return false at the end.
+			bool next(T& t)
+			{
+				if (k == n) {
+					k = 0;
+					n = ring.pop(b.get(), size);
+					if (n == 0) {
+						if (e) {
+							std::rethrow_exception(std::exchange(e, nullptr));
+						}
+
+						return false;
+					}
+				}
+				t = b[k++];
+
+				return true;
+			}
+			// Copy up to m elements to p.
+			std::size_t take(T* p, std::size_t m)
+			{
+				std::size_t j = 0;
+				while (j < m) {
+					if (k < n) {
+						auto l = std::min(m - j, n - k);
+						std::copy_n(b.get() + k, l, p + j);
+						k += l;
+						j += l;
+					}
+					else {
+						auto l = ring.pop(p + j, m - j);
+						if (l == 0) {
+							break;
+						}
+						j += l;
+					}
+				}
+
+				return j;
+			}
+		};
+		std::shared_ptr<state> s;
+		T t;
+		bool ok;
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using reference = const T&;
+		using difference_type = std::ptrdiff_t;
+
+		prefetch()
+			: t{}, ok(false)
+		{ }
+		prefetch(I i, std::size_t capacity = 1 << 12)
+			: s(std::make_shared<state>(i, capacity)), t{}, ok(s->next(t))
+		{ }
+
+		// Both exhausted or sharing a worker.
+		bool operator==(const prefetch& p) const
+		{
+			return ok ? s == p.s : !p.ok;
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return ok;
+		}
+		reference operator*() const noexcept
+		{
+			return t;
+		}
+		prefetch& operator++()
+		{
+			if (ok) {
+				ok = s->next(t);
+			}
+
+			return *this;
+		}
+		prefetch operator++(int)
+		{
+			auto p{ *this };
+
+			operator++();
+
+			return p;
+		}
+
+		std::size_t next_batch(std::span<value_type> b)
+		{
+			if (!ok || b.empty()) {
+				return 0;
+			}
+			b[0] = t;
+			auto m = 1 + s->take(b.data() + 1, b.size() - 1);
+			operator++();
+
+			return m;
+		}
+	};
+
+} // namespace fms::iterable
@@ -0,0 +1,297 @@
+// fms_iterable_recurrence.h - linear recurrences and exponentially weighted averages
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// y[n] = a[0] y[n-1] + ... + a[P-1] y[n-P] + b[0] x[n] + ... + b[Q-1] x[n-Q+1]
+	// where x[n] are elements of i. Values before the first x are 0 and
+	// y[-1], ..., y[-P] are given. The state is fixed size arrays that stay in registers.
+	// There is no next_batch since the loop is latency bound and fuses with its consumer.
+	template <std::size_t P, std::size_t Q, input I, class T = typename I::value_type>
+	class recurrence {
+		static_assert(Q > 0);
+
+		std::array<T, P> a;
+		std::array<T, Q> b;
+		I i;
+		std::array<T, P> y; // y[n-1], ..., y[n-P]
+		std::array<T, Q> x; // x[n], ..., x[n-Q+1]
+		T t; // y[n]
+
+		void step(const T& u)
+		{
+			for (std::size_t j = Q; j-- > 1; ) {
+				x[j] = x[j - 1];
+			}
+			x[0] = u;
+			T s = b[0] * x[0];
+			for (std::size_t j = 1; j < Q; ++j) {
+				s += b[j] * x[j];
+			}
+			for (std::size_t j = 0; j < P; ++j) {
+				s += a[j] * y[j];
+			}
+			for (std::size_t j = P; j-- > 1; ) {
+				y[j] = y[j - 1];
+			}
+			if constexpr (P > 0) {
+				y[0] = s;
+			}
+			t = s;
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using difference_type = typename I::difference_type;
+
+		static constexpr bool infinite = unbounded<I>;
+
+		recurrence(const std::array<T, P>& a, const std::array<T, Q>& b, const I& i, const std::array<T, P>& y = {})
+			: a(a), b(b), i(i), y(y), x{}, t{}
+		{
+			if (this->i) {
+				step(*this->i);
+			}
+		}
+
+		bool operator==(const recurrence& r) const
+		{
+			return i == r.i;
+		}
+
+		explicit operator bool() const
+		{
+			return i.operator bool();
+		}
+		value_type operator*() const
+		{
+			return t;
+		}
+		recurrence& operator++()
+		{
+			if (i && ++i) {
+				step(*i);
+			}
+
+			return *this;
+		}
+		recurrence operator++(int)
+		{
+			auto r{ *this };
+
+			operator++();
+
+			return r;
+		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return i.size();
+		}
+	};
+
+	// Exponentially weighted moving average starting at the first element.
+	// y[0] = x[0], y[n] = (1 - alpha) y[n-1] + alpha x[n]
+	// The recurrence is computed in the type of alpha.
+	template <input I, class T = typename I::value_type>
+	inline auto ewma(T alpha, I i)
+	{
+		static_assert(std::is_floating_point_v<T>, "ewma: alpha must be floating point");
+
+		return recurrence<1, 1, I, T>({ 1 - alpha }, { alpha }, i, { i ? T(*i) : T(0) });
+	}
+
+	// Exponentially weighted variance about the exponentially weighted mean.
+	// d = x[n] - m, m += alpha d, v = (1 - alpha)(v + alpha d^2)
+	template <input I, class T = typename I::value_type>
+	class ewm_variance {
+		static_assert(std::is_floating_point_v<T>, "ewm_variance: alpha must be floating point");
+
+		T alpha;
+		I i;
+		T m, v;
+
+		void step(const T& x)
+		{
+			auto d = x - m;
+			m += alpha * d;
+			v = (1 - alpha) * (v + alpha * d * d);
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using difference_type = typename I::difference_type;
+
+		static constexpr bool infinite = unbounded<I>;
+
+		ewm_variance(T alpha, const I& i)
+			: alpha(alpha), i(i), m(this->i ? T(*this->i) : T(0)), v(0)
+		{ }
+
+		bool operator==(const ewm_variance& e) const
+		{
+			return i == e.i;
+		}
+
+		explicit operator bool() const
+		{
+			return i.operator bool();
+		}
+		value_type operator*() const
+		{
+			return v;
+		}
+		// Current mean.
+		T mean() const
+		{
+			return m;
+		}
+		ewm_variance& operator++()
+		{
+			if (i && ++i) {
+				step(*i);
+			}
+
+			return *this;
+		}
+		ewm_variance operator++(int)
+		{
+			auto e{ *this };
+
+			operator++();
+
+			return e;
+		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return i.size();
+		}
+	};
+
+	// The same recurrence applied independently to each of m columns.
+	// Elements of i are rows of m values, for example one price per instrument.
+	// Each step is a loop over columns with no dependency between them so it vectorizes.
+	// Rows of y and x are kept in rings so nothing is shifted.
+	template <std::size_t P, std::size_t Q, input I, class T = std::remove_cv_t<typename I::value_type::element_type>>
+	class recurrence_columns {
+		static_assert(P > 0 && Q > 0);
+
+		std::array<T, P> a;
+		std::array<T, Q> b;
+		I i;
+		std::size_t m;
+		std::vector<T> y; // P rows, y[n] in row ry, y[n-1-j] in row (ry + j) % P
+		std::vector<T> x; // Q rows, x[n-j] in row (rx + j) % Q
+		std::size_t ry, rx;
+
+		void step(std::span<const T> u)
+		{
+			if (u.size() < m) {
+				throw std::invalid_argument("recurrence_columns: short row");
+			}
+			rx = (rx + Q - 1) % Q;
+			std::copy_n(u.data(), m, x.data() + rx * m);
+			std::array<const T*, Q> xj;
+			for (std::size_t j = 0; j < Q; ++j) {
+				xj[j] = x.data() + ((rx + j) % Q) * m;
+			}
+			std::array<const T*, P> yj;
+			for (std::size_t j = 0; j < P; ++j) {
+				yj[j] = y.data() + ((ry + j) % P) * m;
+			}
+			// y[n-P] is overwritten by y[n] column by column after it is read
+			ry = (ry + P - 1) % P;
+			T* yn = y.data() + ry * m;
+			for (std::size_t c = 0; c < m; ++c) {
+				T s = b[0] * xj[0][c];
+				for (std::size_t j = 1; j < Q; ++j) {
+					s += b[j] * xj[j][c];
+				}
+				for (std::size_t j = 0; j < P; ++j) {
+					s += a[j] * yj[j][c];
+				}
+				yn[c] = s;
+			}
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::span<const T>;
+		using difference_type = typename I::difference_type;
+
+		static constexpr bool infinite = unbounded<I>;
+
+		// y0 is y[-1], ..., y[-P] as P rows of m values, or 0 if empty.
+		recurrence_columns(const std::array<T, P>& a, const std::array<T, Q>& b, const I& i, std::size_t m,
+			std::span<const T> y0 = {})
+			: a(a), b(b), i(i), m(m), y(P * m), x(Q * m), ry(0), rx(0)
+		{
+			std::copy_n(y0.data(), std::min(y0.size(), y.size()), y.data());
+			if (this->i) {
+				step(*this->i);
+			}
+		}
+
+		bool operator==(const recurrence_columns& r) const
+		{
+			return i == r.i;
+		}
+
+		explicit operator bool() const
+		{
+			return i.operator bool();
+		}
+		// Row y[n], valid until this is incremented.
+		value_type operator*() const
+		{
+			return value_type(y.data() + ry * m, m);
+		}
+		recurrence_columns& operator++()
+		{
+			if (i && ++i) {
+				step(*i);
+			}
+
+			return *this;
+		}
+		recurrence_columns operator++(int)
+		{
+			auto r{ *this };
+
+			operator++();
+
+			return r;
+		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return i.size();
+		}
+	};
+
+	// ewma of each column of rows of m values. Rows must hold floating point values.
+	template <input I, class T = std::remove_cv_t<typename I::value_type::element_type>>
+	inline auto ewma_columns(std::type_identity_t<T> alpha, I i, std::size_t m)
+	{
+		static_assert(std::is_floating_point_v<T>, "ewma_columns: rows must be floating point");
+
+		std::span<const T> y0;
+		if (i) {
+			y0 = *i;
+		}
+
+		return recurrence_columns<1, 1, I, T>({ 1 - alpha }, { alpha }, i, m, y0);
+	}
+
+} // namespace fms::iterable
@@ -0,0 +1,334 @@
+// fms_iterable_rolling.h - statistics over a sliding window
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// Window statistics updated in O(1) amortized time.
+	// push(t) adds the newest element, pop(t) removes the oldest, s() is the current value.
+	namespace window {
+
+		template <class T>
+		struct sum {
+			T s = 0;
+
+			void push(const T& t)
+			{
+				s += t;
+			}
+			void pop(const T& t)
+			{
+				s -= t;
+			}
+			T operator()() const
+			{
+				return s;
+			}
+		};
+
+		template <class T>
+		struct mean {
+			T s = 0;
+			std::size_t n = 0;
+
+			void push(const T& t)
+			{
+				s += t;
+				++n;
+			}
+			void pop(const T& t)
+			{
+				s -= t;
+				--n;
+			}
+			T operator()() const
+			{
+				return n ? s / static_cast<T>(n) : T(0);
+			}
+		};
+
+		// Sample variance using Welford's update and its inverse.
+		template <class T>
+		struct variance {
+			T m = 0, m2 = 0;
+			std::size_t n = 0;
+
+			void push(const T& t)
+			{
+				++n;
+				auto d = t - m;
+				m += d / static_cast<T>(n);
+				m2 += d * (t - m);
+			}
+			void pop(const T& t)
+			{
+				if (--n == 0) {
+					m = m2 = 0;
+
+					return;
+				}
+				auto d = t - m;
+				m -= d / static_cast<T>(n);
+				m2 -= d * (t - m);
+			}
+			T operator()() const
+			{
+				return n > 1 ? std::max<T>(m2 / static_cast<T>(n - 1), 0) : T(0);
+			}
+		};
+
+		// Monotonic deque. The front is the extreme and equal elements are kept
+		// so the oldest element is still at the front when it leaves the window.
+		template <class T, class Less = std::less<T>>
+		struct extreme {
+			std::deque<T> d;
+			FMS_NO_UNIQUE_ADDRESS Less less;
+
+			void push(const T& t)
+			{
+				while (!d.empty() && less(t, d.back())) {
+					d.pop_back();
+				}
+				d.push_back(t);
+			}
+			void pop(const T& t)
+			{
+				if (!less(t, d.front()) && !less(d.front(), t)) {
+					d.pop_front();
+				}
+			}
+			T operator()() const
+			{
+				return d.front();
+			}
+		};
+		template <class T>
+		using min = extreme<T, std::less<T>>;
+		template <class T>
+		using max = extreme<T, std::greater<T>>;
+
+	} // namespace window
+
+	// S over the last n elements of i, or fewer at the start.
+	// Elements are kept in a ring of n so each step is one push and one pop.
+	template <class S, input I, class T = typename I::value_type>
+	class rolling {
+		I i;
+		std::vector<T> w; // ring of the last n elements
+		std::size_t k; // next ring position
+		bool full;
+		S s;
+
+		void add(const T& t)
+		{
+			auto& r = w[k];
+			if (full) {
+				s.pop(r);
+			}
+			r = t;
+			s.push(t);
+			if (++k == w.size()) {
+				k = 0;
+				full = true;
+			}
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::remove_cvref_t<std::invoke_result_t<const S&>>;
+		using difference_type = typename I::difference_type;
+
+		static constexpr bool infinite = unbounded<I>;
+
+		rolling(const I& i, std::size_t n, const S& s = S{})
+			: i(i), w(std::max<std::size_t>(n, 1)), k(0), full(false), s(s)
+		{
+			if (this->i) {
+				add(*this->i);
+			}
+		}
+
+		bool operator==(const rolling& r) const
+		{
+			return i == r.i;
+		}
+
+		explicit operator bool() const
+		{
+			return i.operator bool();
+		}
+		value_type operator*() const
+		{
+			return s();
+		}
+		rolling& operator++()
+		{
+			if (i && ++i) {
+				add(*i);
+			}
+
+			return *this;
+		}
+		rolling operator++(int)
+		{
+			auto r{ *this };
+
+			operator++();
+
+			return r;
+		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return i.size();
+		}
+
+		std::size_t next_batch(std::span<value_type> o)
+			requires batched<I, T>
+		{
+			if (o.empty() || !i) {
+				return 0;
+			}
+			o[0] = s();
+			++i;
+			std::size_t n = 1;
+			std::array<T, batch_size> b;
+			while (n < o.size()) {
+				auto r = std::min(b.size(), o.size() - n);
+				auto m = i.next_batch(std::span(b.data(), r));
+				for (std::size_t j = 0; j < m; ++j) {
+					add(b[j]);
+					o[n + j] = s();
+				}
+				n += m;
+				if (m < r) {
+					break;
+				}
+			}
+			if (i) {
+				add(*i);
+			}
+
+			return n;
+		}
+	};
+
+	template <class S, input I>
+	inline auto make_rolling(I i, std::size_t n, const S& s = S{})
+	{
+		return rolling<S, I>(i, n, s);
+	}
+	template <input I, class T = typename I::value_type>
+	inline auto rolling_sum(I i, std::size_t n)
+	{
+		return rolling<window::sum<T>, I>(i, n);
+	}
+	template <input I, class T = typename I::value_type>
+	inline auto rolling_mean(I i, std::size_t n)
+	{
+		return rolling<window::mean<T>, I>(i, n);
+	}
+	template <input I, class T = typename I::value_type>
+	inline auto rolling_variance(I i, std::size_t n)
+	{
+		return rolling<window::variance<T>, I>(i, n);
+	}
+	template <input I, class T = typename I::value_type>
+	inline auto rolling_min(I i, std::size_t n)
+	{
+		return rolling<window::min<T>, I>(i, n);
+	}
+	template <input I, class T = typename I::value_type>
+	inline auto rolling_max(I i, std::size_t n)
+	{
+		return rolling<window::max<T>, I>(i, n);
+	}
+
+	// Timestamped pairs {t, x} to {t, S over x with time in (t - dt, t]}.
+	// Times must be nondecreasing.
+	template <class S, input I, class U = typename I::value_type::first_type, class T = typename I::value_type::second_type>
+	class rolling_time {
+		using D = decltype(std::declval<U>() - std::declval<U>());
+
+		I i;
+		D dt;
+		std::deque<std::pair<U, T>> w;
+		S s;
+
+		void add(const std::pair<U, T>& p)
+		{
+			while (!w.empty() && !(p.first - w.front().first < dt)) {
+				s.pop(w.front().second);
+				w.pop_front();
+			}
+			w.push_back(p);
+			s.push(p.second);
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::pair<U, std::remove_cvref_t<std::invoke_result_t<const S&>>>;
+		using difference_type = typename I::difference_type;
+
+		static constexpr bool infinite = unbounded<I>;
+
+		rolling_time(const I& i, D dt, const S& s = S{})
+			: i(i), dt(dt), s(s)
+		{
+			if (this->i) {
+				add(*this->i);
+			}
+		}
+
+		bool operator==(const rolling_time& r) const
+		{
+			return i == r.i;
+		}
+
+		explicit operator bool() const
+		{
+			return i.operator bool();
+		}
+		value_type operator*() const
+		{
+			return { w.back().first, s() };
+		}
+		rolling_time& operator++()
+		{
+			if (i && ++i) {
+				add(*i);
+			}
+
+			return *this;
+		}
+		rolling_time operator++(int)
+		{
+			auto r{ *this };
+
+			operator++();
+
+			return r;
+		}
+
+		std::size_t size() const
+			requires sized<I>
+		{
+			return i.size();
+		}
+	};
+
+	template <class S, input I, class D>
+	inline auto make_rolling_time(I i, D dt, const S& s = S{})
+	{
+		return rolling_time<S, I>(i, dt, s);
+	}
+
+} // namespace fms::iterable
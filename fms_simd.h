@@ -0,0 +1,691 @@
+// fms_simd.h - SIMD kernels with runtime instruction set dispatch
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#define FMS_SIMD_X86 1
+#define FMS_SIMD_INLINE __attribute__((always_inline)) inline
+#define FMS_SIMD_TARGET(X) __attribute__((target(X)))
+#include <immintrin.h>
+#else
+#define FMS_SIMD_INLINE inline
+#endif
+
+namespace fms::simd {
+
+	enum class isa { scalar, sse2, avx2, avx512 };
+
+	// Best instruction set supported by the cpu.
+	inline isa detect() noexcept
+	{
+#ifdef FMS_SIMD_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) {
+			return isa::avx512;
+		}
+		if (__builtin_cpu_supports("avx2")) {
+			return isa::avx2;
+		}
+
+		return isa::sse2;
+#else
+		return isa::scalar;
+#endif
+	}
+
+	// Instruction set used by kernels. Lower it to exercise other code paths.
+	inline isa& level() noexcept
+	{
+		static isa l = detect();
+
+		return l;
+	}
+
+	// Element-wise operations with vector kernels.
+	enum class op { none, add, sub, mul, div };
+
+	template <class Op, class T>
+	constexpr op op_of()
+	{
+		if constexpr (!std::is_arithmetic_v<T> || std::is_same_v<T, bool>) {
+			return op::none;
+		}
+		else if constexpr (std::is_same_v<Op, std::plus<T>> || std::is_same_v<Op, std::plus<>>) {
+			return op::add;
+		}
+		else if constexpr (std::is_same_v<Op, std::minus<T>> || std::is_same_v<Op, std::minus<>>) {
+			return op::sub;
+		}
+		else if constexpr (std::is_same_v<Op, std::multiplies<T>> || std::is_same_v<Op, std::multiplies<>>) {
+			return op::mul;
+		}
+		else if constexpr (std::is_floating_point_v<T>
+			&& (std::is_same_v<Op, std::divides<T>> || std::is_same_v<Op, std::divides<>>)) {
+			return op::div;
+		}
+		else {
+			return op::none;
+		}
+	}
+
+	template <class Op, class T>
+	concept elementwise = op_of<Op, T>() != op::none;
+
+#ifdef FMS_SIMD_X86
+
+	// N elements of T in a vector register.
+	template <class T, std::size_t N>
+	struct pack_ {
+		typedef T type __attribute__((vector_size(N * sizeof(T))));
+	};
+	template <class T, std::size_t N>
+	using pack = typename pack_<T, N>::type;
+
+	namespace detail {
+
+		// c[k] = a[k] op b[k] using registers holding N elements.
+		// A scalar side (A or B false) reads only a[0] or b[0] and broadcasts it.
+		template <op O, class T, std::size_t N, bool A = true, bool B = true>
+		FMS_SIMD_INLINE void transform(const T* a, const T* b, T* c, std::size_t n)
+		{
+			using V = pack<T, N>;
+			std::size_t k = 0;
+			V x{}, y{};
+
+			// broadcast by assignment since 0 + -0.0 is +0.0
+			for (std::size_t j = 0; j < N; ++j) {
+				if constexpr (!A) {
+					x[j] = a[0];
+				}
+				if constexpr (!B) {
+					y[j] = b[0];
+				}
+			}
+			for (; k + N <= n; k += N) {
+				V z;
+				if constexpr (A) {
+					std::memcpy(&x, a + k, sizeof(V));
+				}
+				if constexpr (B) {
+					std::memcpy(&y, b + k, sizeof(V));
+				}
+				if constexpr (O == op::add) {
+					z = x + y;
+				}
+				else if constexpr (O == op::sub) {
+					z = x - y;
+				}
+				else if constexpr (O == op::mul) {
+					z = x * y;
+				}
+				else if constexpr (O == op::div) {
+					z = x / y;
+				}
+				std::memcpy(c + k, &z, sizeof(V));
+			}
+			for (; k < n; ++k) {
+				const T& u = a[A ? k : 0];
+				const T& v = b[B ? k : 0];
+				if constexpr (O == op::add) {
+					c[k] = u + v;
+				}
+				else if constexpr (O == op::sub) {
+					c[k] = u - v;
+				}
+				else if constexpr (O == op::mul) {
+					c[k] = u * v;
+				}
+				else if constexpr (O == op::div) {
+					c[k] = u / v;
+				}
+			}
+		}
+		template <op O, class T, bool A, bool B>
+		FMS_SIMD_TARGET("avx512f") void transform_avx512(const T* a, const T* b, T* c, std::size_t n)
+		{
+			transform<O, T, 64 / sizeof(T), A, B>(a, b, c, n);
+		}
+		template <op O, class T, bool A, bool B>
+		FMS_SIMD_TARGET("avx2") void transform_avx2(const T* a, const T* b, T* c, std::size_t n)
+		{
+			transform<O, T, 32 / sizeof(T), A, B>(a, b, c, n);
+		}
+		template <op O, class T, bool A, bool B>
+		inline void transform_sse2(const T* a, const T* b, T* c, std::size_t n)
+		{
+			transform<O, T, 16 / sizeof(T), A, B>(a, b, c, n);
+		}
+
+	} // namespace detail
+
+#endif // FMS_SIMD_X86
+
+	namespace detail {
+
+		// Use the widest registers available when a and b are arrays (A, B) or scalars.
+		template <bool A, bool B, class Op, class T>
+		inline void transform(const Op& f, const T* a, const T* b, T* c, std::size_t n)
+		{
+#ifdef FMS_SIMD_X86
+			if constexpr (elementwise<Op, T>) {
+				constexpr op O = op_of<Op, T>();
+
+				switch (level()) {
+				case isa::avx512:
+					return transform_avx512<O, T, A, B>(a, b, c, n);
+				case isa::avx2:
+					return transform_avx2<O, T, A, B>(a, b, c, n);
+				case isa::sse2:
+					return transform_sse2<O, T, A, B>(a, b, c, n);
+				default:
+					break;
+				}
+			}
+#endif
+			for (std::size_t k = 0; k < n; ++k) {
+				c[k] = f(a[A ? k : 0], b[B ? k : 0]);
+			}
+		}
+
+	} // namespace detail
+
+	// c[k] = op(a[k], b[k]) for k < n. Output may alias an input.
+	template <class Op, class T>
+	inline void transform(const Op& f, const T* a, const T* b, T* c, std::size_t n)
+	{
+		detail::transform<true, true>(f, a, b, c, n);
+	}
+	// c[k] = op(a[k], b) for k < n.
+	template <class Op, class T>
+	inline void transform(const Op& f, const T* a, const T& b, T* c, std::size_t n)
+	{
+		detail::transform<true, false>(f, a, &b, c, n);
+	}
+	// c[k] = op(a, b[k]) for k < n.
+	template <class Op, class T>
+	inline void transform(const Op& f, const T& a, const T* b, T* c, std::size_t n)
+	{
+		detail::transform<false, true>(f, &a, b, c, n);
+	}
+
+	// Summation methods for accumulator.
+	enum class summation {
+		fast,         // independent accumulators in SIMD lanes
+		compensated,  // Kahan-Neumaier style error term (TwoSum) in every lane
+		pairwise,     // blocks of lanes combined in a binary tree
+		reproducible, // bit-identical for any block size or thread count
+	};
+
+	// a + b = s + e exactly
+	template <class T>
+	FMS_SIMD_INLINE void two_sum(T a, T b, T& s, T& e)
+	{
+		s = a + b;
+		T b_ = s - a;
+		e = (a - (s - b_)) + (b - b_);
+	}
+
+#ifdef FMS_SIMD_X86
+
+	namespace detail {
+
+		// Add or multiply p[0, n) into K lanes with carries c. n must be a multiple of K.
+		template <op O, bool C, class T, std::size_t K>
+		FMS_SIMD_INLINE void lanes(T* s, T* c, const T* p, std::size_t n)
+		{
+			using V = pack<T, K>;
+			V s_, c_;
+			std::memcpy(&s_, s, sizeof(V));
+			if constexpr (C) {
+				std::memcpy(&c_, c, sizeof(V));
+			}
+
+			for (std::size_t k = 0; k < n; k += K) {
+				V x;
+				std::memcpy(&x, p + k, sizeof(V));
+				if constexpr (O == op::mul) {
+					s_ = s_ * x;
+				}
+				else if constexpr (C) {
+					V t = s_ + x;
+					V x_ = t - s_;
+					c_ += (s_ - (t - x_)) + (x - x_);
+					s_ = t;
+				}
+				else {
+					s_ = s_ + x;
+				}
+			}
+
+			std::memcpy(s, &s_, sizeof(V));
+			if constexpr (C) {
+				std::memcpy(c, &c_, sizeof(V));
+			}
+		}
+		template <op O, bool C, class T, std::size_t K>
+		FMS_SIMD_TARGET("avx512f") void lanes_avx512(T* s, T* c, const T* p, std::size_t n)
+		{
+			lanes<O, C, T, K>(s, c, p, n);
+		}
+		template <op O, bool C, class T, std::size_t K>
+		FMS_SIMD_TARGET("avx2") void lanes_avx2(T* s, T* c, const T* p, std::size_t n)
+		{
+			lanes<O, C, T, K>(s, c, p, n);
+		}
+		template <op O, bool C, class T, std::size_t K>
+		inline void lanes_sse2(T* s, T* c, const T* p, std::size_t n)
+		{
+			lanes<O, C, T, K>(s, c, p, n);
+		}
+
+	} // namespace detail
+
+#endif // FMS_SIMD_X86
+
+	// Streaming floating point sum (or product) using K independent lanes.
+	// Element j of the stream is always accumulated in lane j % K so the
+	// result does not depend on how the stream is split into calls to add.
+	template <class T, summation S = summation::fast, op O = op::add>
+	class accumulator {
+		static_assert(std::is_floating_point_v<T>);
+		static_assert(O == op::add || (O == op::mul && S == summation::fast));
+	public:
+		static constexpr std::size_t lanes = 256 / sizeof(T);
+		// Elements per block for pairwise and reproducible.
+		static constexpr std::size_t block = 4096;
+	private:
+		static constexpr bool C = S == summation::compensated;
+		static constexpr bool blocked = S == summation::pairwise || S == summation::reproducible;
+		static constexpr T id = O == op::mul ? T(1) : T(0);
+
+		T s[lanes], c[lanes]; // lanes and carries
+		T total, carry; // completed blocks
+		std::size_t pos; // stream position in current block
+		// pairwise block sums
+		T tree[64];
+		std::size_t blocks;
+
+		void lane_add(std::size_t l, T x)
+		{
+			if constexpr (O == op::mul) {
+				s[l] *= x;
+			}
+			else if constexpr (C) {
+				T e;
+				two_sum(s[l], x, s[l], e);
+				c[l] += e;
+			}
+			else {
+				s[l] += x;
+			}
+		}
+		void kernel(const T* p, std::size_t n)
+		{
+#ifdef FMS_SIMD_X86
+			switch (level()) {
+			case isa::avx512:
+				return detail::lanes_avx512<O, C, T, lanes>(s, c, p, n);
+			case isa::avx2:
+				return detail::lanes_avx2<O, C, T, lanes>(s, c, p, n);
+			case isa::sse2:
+				return detail::lanes_sse2<O, C, T, lanes>(s, c, p, n);
+			default:
+				break;
+			}
+#endif
+			for (std::size_t k = 0; k < n; k += lanes) {
+				for (std::size_t l = 0; l < lanes; ++l) {
+					lane_add(l, p[k + l]);
+				}
+			}
+		}
+		// fold into lanes starting at pos
+		void add_lanes(const T* p, std::size_t n)
+		{
+			std::size_t k = 0;
+			for (; k < n && pos % lanes; ++k, ++pos) {
+				lane_add(pos % lanes, p[k]);
+			}
+			auto m = (n - k) / lanes * lanes;
+			kernel(p + k, m);
+			k += m;
+			pos += m;
+			for (; k < n; ++k, ++pos) {
+				lane_add(pos % lanes, p[k]);
+			}
+		}
+		void flush()
+		{
+			add_block(lane_value());
+			std::fill(s, s + lanes, id);
+			std::fill(c, c + lanes, T(0));
+			pos = 0;
+		}
+	public:
+		accumulator(T t = id) noexcept
+			: total(t), carry(0), pos(0), blocks(0)
+		{
+			std::fill(s, s + lanes, id);
+			std::fill(c, c + lanes, T(0));
+		}
+
+		accumulator& add(const T* p, std::size_t n)
+		{
+			if constexpr (blocked) {
+				while (n) {
+					if (pos == block) {
+						flush();
+					}
+					auto m = std::min(n, block - pos);
+					add_lanes(p, m);
+					p += m;
+					n -= m;
+				}
+			}
+			else {
+				add_lanes(p, n);
+			}
+
+			return *this;
+		}
+		accumulator& add(T x)
+		{
+			return add(&x, 1);
+		}
+
+		// Combine lanes of the current block in a fixed order.
+		T lane_value() const
+		{
+			T s_[lanes], c_[lanes];
+			std::copy(s, s + lanes, s_);
+			std::copy(c, c + lanes, c_);
+			for (std::size_t w = lanes / 2; w; w /= 2) {
+				for (std::size_t l = 0; l < w; ++l) {
+					if constexpr (O == op::mul) {
+						s_[l] *= s_[l + w];
+					}
+					else if constexpr (C) {
+						T e;
+						two_sum(s_[l], s_[l + w], s_[l], e);
+						c_[l] += c_[l + w] + e;
+					}
+					else {
+						s_[l] += s_[l + w];
+					}
+				}
+			}
+
+			return C ? s_[0] + c_[0] : s_[0];
+		}
+		// Fold the value of a completed block into the total.
+		void add_block(T v)
+		{
+			if constexpr (S == summation::pairwise) {
+				std::size_t l = 0;
+				for (; blocks & (std::size_t(1) << l); ++l) {
+					v = tree[l] + v;
+				}
+				tree[l] = v;
+				++blocks;
+			}
+			else if constexpr (S == summation::reproducible) {
+				T e;
+				two_sum(total, v, total, e);
+				carry += e;
+			}
+			else if constexpr (O == op::mul) {
+				total *= v;
+			}
+			else {
+				total += v;
+			}
+		}
+
+		T value() const
+		{
+			T v = pos ? lane_value() : id;
+
+			if constexpr (S == summation::pairwise) {
+				for (std::size_t l = 0; l < 64; ++l) {
+					if (blocks & (std::size_t(1) << l)) {
+						v = tree[l] + v;
+					}
+				}
+
+				return total + v;
+			}
+			else if constexpr (S == summation::reproducible) {
+				T t = total, e;
+				two_sum(t, v, t, e);
+
+				return t + (carry + e);
+			}
+			else if constexpr (O == op::mul) {
+				return total * v;
+			}
+			else {
+				return total + v;
+			}
+		}
+	};
+
+	// Sum of p[0, n).
+	template <summation S = summation::fast, class T>
+	inline T sum(const T* p, std::size_t n, T t = 0)
+	{
+		return accumulator<T, S>(t).add(p, n).value();
+	}
+
+	// Comparisons with a scalar that have compress kernels.
+	enum class cmp { none, lt, le, gt, ge };
+
+	template <class Op, class T>
+	constexpr cmp cmp_of()
+	{
+		if constexpr (!std::is_arithmetic_v<T>) {
+			return cmp::none;
+		}
+		else if constexpr (std::is_same_v<Op, std::less<T>> || std::is_same_v<Op, std::less<>>) {
+			return cmp::lt;
+		}
+		else if constexpr (std::is_same_v<Op, std::less_equal<T>> || std::is_same_v<Op, std::less_equal<>>) {
+			return cmp::le;
+		}
+		else if constexpr (std::is_same_v<Op, std::greater<T>> || std::is_same_v<Op, std::greater<>>) {
+			return cmp::gt;
+		}
+		else if constexpr (std::is_same_v<Op, std::greater_equal<T>> || std::is_same_v<Op, std::greater_equal<>>) {
+			return cmp::ge;
+		}
+		else {
+			return cmp::none;
+		}
+	}
+
+	template <class Op, class T>
+	concept comparison = cmp_of<Op, T>() != cmp::none;
+
+	namespace detail {
+
+		// Branchless: always write, advance only on a match.
+		template <class Op, class T>
+		inline std::size_t compress(const Op& f, const T* a, std::size_t n, const T& t, T* c)
+		{
+			std::size_t m = 0;
+
+			for (std::size_t k = 0; k < n; ++k) {
+				T x = a[k];
+				c[m] = x;
+				m += f(x, t) ? 1 : 0;
+			}
+
+			return m;
+		}
+
+#ifdef FMS_SIMD_X86
+
+		template <cmp C, class T>
+		inline std::size_t compress(const T* a, std::size_t n, const T& t, T* c)
+		{
+			if constexpr (C == cmp::lt) {
+				return compress(std::less<T>{}, a, n, t, c);
+			}
+			else if constexpr (C == cmp::le) {
+				return compress(std::less_equal<T>{}, a, n, t, c);
+			}
+			else if constexpr (C == cmp::gt) {
+				return compress(std::greater<T>{}, a, n, t, c);
+			}
+			else {
+				return compress(std::greater_equal<T>{}, a, n, t, c);
+			}
+		}
+
+		template <cmp C>
+		constexpr int cmp_ps()
+		{
+			return C == cmp::lt ? _CMP_LT_OQ : C == cmp::le ? _CMP_LE_OQ : C == cmp::gt ? _CMP_GT_OQ : _CMP_GE_OQ;
+		}
+		template <cmp C>
+		constexpr int cmp_epi()
+		{
+			return C == cmp::lt ? _MM_CMPINT_LT : C == cmp::le ? _MM_CMPINT_LE : C == cmp::gt ? _MM_CMPINT_NLE : _MM_CMPINT_NLT;
+		}
+
+		// Compress store the lanes that compare true.
+		template <cmp C, class T>
+		FMS_SIMD_TARGET("avx512f") std::size_t compress_avx512(const T* a, std::size_t n, T t, T* c)
+		{
+			constexpr int P = std::is_floating_point_v<T> ? cmp_ps<C>() : cmp_epi<C>();
+			constexpr std::size_t L = 64 / sizeof(T);
+			std::size_t k = 0, m = 0;
+
+			for (; k + L <= n; k += L) {
+				unsigned mask;
+				if constexpr (std::is_same_v<T, double>) {
+					auto x = _mm512_loadu_pd(a + k);
+					mask = _mm512_cmp_pd_mask(x, _mm512_set1_pd(t), P);
+					_mm512_mask_compressstoreu_pd(c + m, __mmask8(mask), x);
+				}
+				else if constexpr (std::is_same_v<T, float>) {
+					auto x = _mm512_loadu_ps(a + k);
+					mask = _mm512_cmp_ps_mask(x, _mm512_set1_ps(t), P);
+					_mm512_mask_compressstoreu_ps(c + m, __mmask16(mask), x);
+				}
+				else if constexpr (sizeof(T) == 8) {
+					auto x = _mm512_loadu_si512(a + k);
+					auto y = _mm512_set1_epi64(static_cast<long long>(t));
+					if constexpr (std::is_signed_v<T>) {
+						mask = _mm512_cmp_epi64_mask(x, y, P);
+					}
+					else {
+						mask = _mm512_cmp_epu64_mask(x, y, P);
+					}
+					_mm512_mask_compressstoreu_epi64(c + m, __mmask8(mask), x);
+				}
+				else {
+					auto x = _mm512_loadu_si512(a + k);
+					auto y = _mm512_set1_epi32(static_cast<int>(t));
+					if constexpr (std::is_signed_v<T>) {
+						mask = _mm512_cmp_epi32_mask(x, y, P);
+					}
+					else {
+						mask = _mm512_cmp_epu32_mask(x, y, P);
+					}
+					_mm512_mask_compressstoreu_epi32(c + m, __mmask16(mask), x);
+				}
+				m += std::popcount(mask);
+			}
+
+			return m + compress<C>(a + k, n - k, t, c + m);
+		}
+
+		// Source lane of each output lane for an 8 bit mask, one byte per lane.
+		inline constexpr auto left_pack = [] {
+			std::array<std::uint64_t, 256> p{};
+			for (unsigned mask = 0; mask < 256; ++mask) {
+				unsigned l = 0;
+				for (unsigned j = 0; j < 8; ++j) {
+					if (mask & (1u << j)) {
+						p[mask] |= std::uint64_t(j) << (8 * l++);
+					}
+				}
+			}
+			return p;
+		}();
+		// Mask of 4 doubles as a mask of 8 floats.
+		inline constexpr std::array<std::uint8_t, 16> double_mask = {
+			0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F, 0xC0, 0xC3, 0xCC, 0xCF, 0xF0, 0xF3, 0xFC, 0xFF
+		};
+
+		// Permute the lanes that compare true to the front and store the whole register.
+		template <cmp C, class T>
+		FMS_SIMD_TARGET("avx2") std::size_t compress_avx2(const T* a, std::size_t n, T t, T* c)
+		{
+			constexpr int P = cmp_ps<C>();
+			constexpr std::size_t L = 32 / sizeof(T);
+			std::size_t k = 0, m = 0;
+
+			for (; k + L <= n; k += L) {
+				__m256 x;
+				unsigned mask, count;
+				if constexpr (std::is_same_v<T, double>) {
+					auto y = _mm256_loadu_pd(a + k);
+					auto mask4 = _mm256_movemask_pd(_mm256_cmp_pd(y, _mm256_set1_pd(t), P));
+					x = _mm256_castpd_ps(y);
+					mask = double_mask[mask4];
+					count = std::popcount(unsigned(mask4));
+				}
+				else {
+					x = _mm256_loadu_ps(a + k);
+					mask = _mm256_movemask_ps(_mm256_cmp_ps(x, _mm256_set1_ps(t), P));
+					count = std::popcount(mask);
+				}
+				auto i = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(left_pack[mask])));
+				_mm256_storeu_ps(reinterpret_cast<float*>(c + m), _mm256_permutevar8x32_ps(x, i));
+				m += count;
+			}
+
+			return m + compress<C>(a + k, n - k, t, c + m);
+		}
+
+#endif // FMS_SIMD_X86
+
+	} // namespace detail
+
+	// Copy a[k] with f(a[k], t) to c in order and return the number copied.
+	// c may equal a. Vector kernels may write past the result but not past c + n.
+	template <class Op, class T>
+	inline std::size_t compress(const Op& f, const T* a, std::size_t n, const T& t, T* c)
+	{
+#ifdef FMS_SIMD_X86
+		if constexpr (comparison<Op, T>) {
+			constexpr cmp C = cmp_of<Op, T>();
+			// float and double only, long double takes the scalar path
+			constexpr bool fp = std::is_same_v<T, float> || std::is_same_v<T, double>;
+			constexpr bool avx512 = fp || ((sizeof(T) == 4 || sizeof(T) == 8) && std::is_integral_v<T>);
+			constexpr bool avx2 = fp;
+
+			if constexpr (avx512) {
+				if (level() == isa::avx512) {
+					return detail::compress_avx512<C>(a, n, t, c);
+				}
+			}
+			if constexpr (avx2) {
+				if (level() >= isa::avx2) {
+					return detail::compress_avx2<C>(a, n, t, c);
+				}
+			}
+		}
+#endif
+		return detail::compress(f, a, n, t, c);
+	}
+
+} // namespace fms::simd
@@ -0,0 +1,142 @@
+// fms_thread_pool.h - fixed size pool of worker threads
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace fms {
+
+	class thread_pool {
+		std::vector<std::thread> threads;
+		std::queue<std::function<void()>> tasks;
+		std::mutex m;
+		std::condition_variable cv;
+		bool stop;
+
+		void work()
+		{
+			for (;;) {
+				std::function<void()> task;
+				{
+					std::unique_lock lock(m);
+					cv.wait(lock, [this] { return stop || !tasks.empty(); });
+					if (stop && tasks.empty()) {
+						return;
+					}
+					task = std::move(tasks.front());
+					tasks.pop();
+				}
+				task();
+			}
+		}
+	public:
+		// Zero threads runs everything on the calling thread.
+		explicit thread_pool(std::size_t n = std::thread::hardware_concurrency())
+			: stop(false)
+		{
+			threads.reserve(n);
+			for (std::size_t k = 0; k < n; ++k) {
+				threads.emplace_back([this] { work(); });
+			}
+		}
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+		~thread_pool()
+		{
+			{
+				std::lock_guard lock(m);
+				stop = true;
+			}
+			cv.notify_all();
+			for (auto& t : threads) {
+				t.join();
+			}
+		}
+
+		// Number of worker threads.
+		std::size_t size() const noexcept
+		{
+			return threads.size();
+		}
+
+		// Queue f to run on a worker.
+		void submit(std::function<void()> f)
+		{
+			{
+				std::lock_guard lock(m);
+				tasks.push(std::move(f));
+			}
+			cv.notify_one();
+		}
+
+		// Call f(k) for k in [0, n) on the workers and the calling thread.
+		// Return when all calls are done and rethrow the first exception.
+		template <class F>
+		void run(std::size_t n, F&& f)
+		{
+			struct state {
+				std::atomic<std::size_t> next{0}, done{0};
+				std::size_t n;
+				std::function<void(std::size_t)> f;
+				std::mutex m;
+				std::condition_variable cv;
+				std::exception_ptr e;
+
+				// Claim and call until no work is left.
+				void work()
+				{
+					for (auto k = next++; k < n; k = next++) {
+						try {
+							f(k);
+						}
+						catch (...) {
+							std::lock_guard lock(m);
+							if (!e) {
+								e = std::current_exception();
+							}
+						}
+						if (++done == n) {
+							std::lock_guard lock(m);
+							cv.notify_all();
+						}
+					}
+				}
+			};
+			if (n == 0) {
+				return;
+			}
+
+			// Workers may start after run returns so they share ownership.
+			auto s = std::make_shared<state>();
+			s->n = n;
+			s->f = std::ref(f);
+			for (std::size_t k = 1; k < std::min(n, size() + 1); ++k) {
+				submit([s] { s->work(); });
+			}
+			s->work();
+			{
+				std::unique_lock lock(s->m);
+				s->cv.wait(lock, [&s] { return s->done == s->n; });
+			}
+			if (s->e) {
+				std::rethrow_exception(s->e);
+			}
+		}
+	};
+
+	// Shared pool with one thread per core.
+	inline thread_pool& default_thread_pool()
+	{
+		static thread_pool pool;
+
+		return pool;
+	}
+
+} // namespace fms
@@ -1,6 +1,12 @@
 // fms_time.h - Time a function call.
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <ostream>
+#include <string>
+#include <vector>
 
 namespace fms {
 
@@ -8,11 +14,129 @@ namespace fms {
 	template<class F, class U = std::chrono::milliseconds>
 	inline auto time(F&& f, std::size_t n = 1)
 	{
-		auto start = std::chrono::high_resolution_clock::now();
+		auto start = std::chrono::steady_clock::now();
 		while (n--) f();
-		auto stop = std::chrono::high_resolution_clock::now();
+		auto stop = std::chrono::steady_clock::now();
 
 		return std::chrono::duration_cast<U>(stop - start).count();
 	}
 
+	// Force the compiler to materialize t.
+	template<class T>
+	inline void do_not_optimize(const T& t)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(t) : "memory");
+#else
+		static const volatile void* sink;
+		sink = &t;
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+	}
+
+	// Force the compiler to assume all memory was read and written.
+	inline void clobber()
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : : "memory");
+#else
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+	}
+
+	// Timing statistics in nanoseconds per element.
+	struct timing {
+		std::string name;
+		std::size_t elements = 0; // per call
+		std::size_t calls = 0; // per repetition
+		std::size_t repetitions = 0;
+		double min = 0, median = 0, p99 = 0, max = 0, mean = 0;
+	};
+
+	// Time f() that processes n elements. Return ns/element statistics across repetitions.
+	// Each repetition calls f() enough times to last at least min_time after warmup calls.
+	// The p99 is the nearest rank so it is below the maximum only for more than 100 repetitions.
+	template<class F>
+	inline timing benchmark(const std::string& name, F&& f, std::size_t n = 1, std::size_t repetitions = 301,
+		std::size_t warmup = 3, std::chrono::nanoseconds min_time = std::chrono::microseconds(200))
+	{
+		using clock = std::chrono::steady_clock;
+
+		while (warmup--) {
+			f();
+			clobber();
+		}
+
+		// calls per repetition
+		std::size_t calls = 1;
+		for (;;) {
+			auto start = clock::now();
+			for (std::size_t k = 0; k < calls; ++k) {
+				f();
+				clobber();
+			}
+			auto dt = clock::now() - start;
+			if (dt >= min_time || calls >= (std::size_t(1) << 30)) {
+				break;
+			}
+			calls *= 2;
+		}
+
+		std::vector<double> ns(std::max<std::size_t>(repetitions, 1));
+		for (auto& t : ns) {
+			auto start = clock::now();
+			for (std::size_t k = 0; k < calls; ++k) {
+				f();
+				clobber();
+			}
+			auto dt = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+			t = dt / (double(calls) * double(std::max<std::size_t>(n, 1)));
+		}
+		std::sort(ns.begin(), ns.end());
+
+		timing t;
+		t.name = name;
+		t.elements = n;
+		t.calls = calls;
+		t.repetitions = ns.size();
+		t.min = ns.front();
+		t.median = ns[ns.size() / 2];
+		t.p99 = ns[static_cast<std::size_t>(std::ceil(0.99 * double(ns.size()))) - 1];
+		t.max = ns.back();
+		double sum = 0;
+		for (auto t_ : ns) {
+			sum += t_;
+		}
+		t.mean = sum / ns.size();
+
+		return t;
+	}
+
+	inline std::ostream& write_csv(std::ostream& os, const std::vector<timing>& ts)
+	{
+		os << "name,elements,calls,repetitions,min,median,p99,max,mean\n";
+		for (const auto& t : ts) {
+			os << t.name << ',' << t.elements << ',' << t.calls << ',' << t.repetitions << ','
+				<< t.min << ',' << t.median << ',' << t.p99 << ',' << t.max << ',' << t.mean << '\n';
+		}
+
+		return os;
+	}
+
+	inline std::ostream& write_json(std::ostream& os, const std::vector<timing>& ts)
+	{
+		os << "[\n";
+		for (std::size_t k = 0; k < ts.size(); ++k) {
+			const auto& t = ts[k];
+			os << "  {\"name\": \"" << t.name << "\", \"elements\": " << t.elements
+				<< ", \"calls\": " << t.calls << ", \"repetitions\": " << t.repetitions
+				 << ", \"min\": " << t.min << ", \"median\": " << t.median
+				<< ", \"p99\": " << t.p99 << ", \"max\": " << t.max << ", \"mean\": " << t.mean << "}"
+				<< (k + 1 < ts.size() ? ",\n" : "\n");
+		}
+		os << "]\n";
+
+		return os;
+	}
+
 } // namespace fms